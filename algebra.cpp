@@ -141,3 +141,62 @@ Matrix4x4 Matrix4x4::invert() const
 
   return ret;
 }
+
+Matrix4x4 translation(const Vector3D& displacement)
+{
+  Matrix4x4 t;
+  t[0][3] = displacement[0];
+  t[1][3] = displacement[1];
+  t[2][3] = displacement[2];
+  return t;
+}
+
+Matrix4x4 scaling(const Vector3D& scale)
+{
+  Matrix4x4 s;
+  s[0][0] = scale[0];
+  s[1][1] = scale[1];
+  s[2][2] = scale[2];
+  return s;
+}
+
+Matrix4x4 rotation(double angle, char axis)
+{
+  Matrix4x4 r;
+  double c = cos(angle * M_PI / 180.0);
+  double s = sin(angle * M_PI / 180.0);
+
+  // The two axes that turn into each other
+  size_t a, b;
+  switch(axis) {
+  case 'x':
+    a = 1; b = 2;
+    break;
+  case 'y':
+    a = 2; b = 0;
+    break;
+  default:
+    a = 0; b = 1;
+    break;
+  }
+
+  r[a][a] = c;
+  r[a][b] = -s;
+  r[b][a] = s;
+  r[b][b] = c;
+  return r;
+}
+
+Matrix4x4 perspective(double fovy, double aspect, double near, double far)
+{
+  Matrix4x4 p;
+  double f = 1.0 / tan(fovy * M_PI / 360.0);
+
+  p[0][0] = f / aspect;
+  p[1][1] = f;
+  p[2][2] = (far + near) / (near - far);
+  p[2][3] = 2.0 * far * near / (near - far);
+  p[3][2] = -1.0;
+  p[3][3] = 0.0;
+  return p;
+}
@@ -421,6 +421,15 @@ inline std::ostream& operator <<(std::ostream& os, const Matrix4x4& M)
             << M[3][2] << " " << M[3][3] << "]";
 }
 
+// Transformations, for column vectors: M * p.  Angles are in degrees,
+// and the axis of a rotation is one of 'x', 'y' or 'z'.  These build
+// the same matrices as glTranslated, glScaled, glRotated and
+// gluPerspective.
+Matrix4x4 translation(const Vector3D& displacement);
+Matrix4x4 scaling(const Vector3D& scale);
+Matrix4x4 rotation(double angle, char axis);
+Matrix4x4 perspective(double fovy, double aspect, double near, double far);
+
 class Colour
 {
 public:
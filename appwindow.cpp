@@ -16,6 +16,8 @@ AppWindow::AppWindow()
 	sigc::slot1<void, Viewer::DrawMode> draw_slot = sigc::mem_fun(m_viewer, &Viewer::setDrawMode);
 	sigc::slot1<void, Viewer::Speed> speed_slot = sigc::mem_fun(m_viewer, &Viewer::setSpeed);
 	sigc::slot0<void> buffer_slot = sigc::mem_fun(m_viewer, &Viewer::toggleBuffer);
+	sigc::slot0<void> stats_slot = sigc::mem_fun(m_viewer, &Viewer::toggleStats);
+	sigc::slot0<void> score_slot = sigc::mem_fun(m_viewer, &Viewer::toggleScoreInView);
 
 	// Set up the application menu
 	// The slot we use here just causes AppWindow::hide() on this,
@@ -35,11 +37,15 @@ AppWindow::AppWindow()
 
 	m_menu_buffer.items().push_back(CheckMenuElem("_Double Buffer", Gtk::AccelKey("b"), buffer_slot ));
 	
+	m_menu_stats.items().push_back(CheckMenuElem("_Performance Overlay", Gtk::AccelKey("p"), stats_slot ));
+	m_menu_stats.items().push_back(CheckMenuElem("_Score In View", Gtk::AccelKey("s"), score_slot ));
+	
 	// Set up the menu bar
 	m_menubar.items().push_back(Gtk::Menu_Helpers::MenuElem("_File", m_menu_app));
 	m_menubar.items().push_back(Gtk::Menu_Helpers::MenuElem("_Draw Mode", m_menu_drawMode));
 	m_menubar.items().push_back(Gtk::Menu_Helpers::MenuElem("_Speed", m_menu_speed));
 	m_menubar.items().push_back(Gtk::Menu_Helpers::MenuElem("_Buffer", m_menu_buffer));	
+	m_menubar.items().push_back(Gtk::Menu_Helpers::MenuElem("S_tats", m_menu_stats));
 	
 	// Set up the score label	
 	scoreLabel.set_text("Score:\t0");
@@ -26,6 +26,7 @@ private:
 	Gtk::Menu m_menu_drawMode;
 	Gtk::Menu m_menu_buffer;
 	Gtk::Menu m_menu_speed;
+	Gtk::Menu m_menu_stats;
 	Gtk::RadioButtonGroup m_group_speed;
 	// The main OpenGL area
 	Viewer m_viewer;
@@ -0,0 +1,154 @@
+//---------------------------------------------------------------------------
+//
+// batch.hpp/batch.cpp
+//
+// Plays a large number of independent games across a pool of worker
+// threads.  Each worker owns its Game and Policy and keeps its own
+// SimStats; the only thing shared while games are running is the queue
+// of game indices, which is split across the workers and rebalanced by
+// stealing.
+//
+//---------------------------------------------------------------------------
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "batch.hpp"
+
+BatchConfig::BatchConfig()
+  : width(10)
+  , height(20)
+  , randomiser(Game::UNIFORM)
+  , games(1000)
+  , seed(1)
+  , maxTicks(0)
+  , threads(0)
+  , chunk(64)
+{}
+
+// The chunks still to be played by one worker, as a range of chunk
+// indices.  The owner takes chunks from the front; a thief takes the
+// back half.  The padding keeps neighbouring queues off each other's
+// cache lines, and the lock is only contended when somebody is stealing.
+struct WorkQueue
+{
+  std::mutex lock;
+  long begin;
+  long end;
+  char padding[64];
+};
+
+static bool popChunk(WorkQueue& q, long& chunk)
+{
+  std::lock_guard<std::mutex> guard(q.lock);
+  if(q.begin >= q.end) {
+    return false;
+  }
+  chunk = q.begin++;
+  return true;
+}
+
+// Move the back half of some other worker's chunks into our own queue.
+// Victims are tried in turn starting with our neighbour, so thieves
+// spread out instead of all hitting the same queue.
+static bool steal(WorkQueue* queues, int nqueues, int self)
+{
+  for(int i = 1; i < nqueues; ++i) {
+    WorkQueue& victim = queues[(self + i) % nqueues];
+    long begin, end;
+    {
+      std::lock_guard<std::mutex> guard(victim.lock);
+      long n = victim.end - victim.begin;
+      if(n <= 0) {
+        continue;
+      }
+      end = victim.end;
+      begin = end - (n + 1) / 2;
+      victim.end = begin;
+    }
+
+    std::lock_guard<std::mutex> guard(queues[self].lock);
+    queues[self].begin = begin;
+    queues[self].end = end;
+    return true;
+  }
+  return false;
+}
+
+BatchRunner::BatchRunner(const BatchConfig& config, PolicyFactory factory)
+  : config_(config)
+  , factory_(factory)
+  , steals_(0)
+{
+  if(config_.threads <= 0) {
+    config_.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  config_.chunk = std::max(1L, config_.chunk);
+}
+
+SimStats BatchRunner::run()
+{
+  const int nthreads = config_.threads;
+  const long nchunks = (config_.games + config_.chunk - 1) / config_.chunk;
+
+  // Deal the chunks out evenly to begin with; stealing only has to fix
+  // up the imbalance that builds up as games run for different lengths.
+  std::unique_ptr<WorkQueue[]> queues(new WorkQueue[nthreads]);
+  for(int w = 0; w < nthreads; ++w) {
+    queues[w].begin = nchunks * w / nthreads;
+    queues[w].end = nchunks * (w + 1) / nthreads;
+  }
+
+  workerStats_.assign(nthreads, SimStats());
+  std::vector<long> steals(nthreads, 0);
+  std::vector<std::thread> threads;
+
+  for(int w = 0; w < nthreads; ++w) {
+    threads.push_back(std::thread([this, w, nthreads, &queues, &steals]() {
+      std::unique_ptr<Policy> policy(factory_(w));
+      Game game(config_.width, config_.height);
+      game.setRandomiser(config_.randomiser);
+
+      SimStats stats;
+      long stolen = 0;
+
+      while(true) {
+        long chunk;
+        if(!popChunk(queues[w], chunk)) {
+          if(!steal(queues.get(), nthreads, w)) {
+            break;
+          }
+          ++stolen;
+          continue;
+        }
+
+        long first = chunk * config_.chunk;
+        long last = std::min(first + config_.chunk, config_.games);
+        for(long g = first; g < last; ++g) {
+          uint64_t seed = streamSeed(config_.seed, g);
+          game.reset(seed);
+          policy->reset(~seed);
+          playGame(game, *policy, stats, config_.maxTicks);
+        }
+      }
+
+      // Publish once, at the end.
+      workerStats_[w] = stats;
+      steals[w] = stolen;
+    }));
+  }
+
+  for(size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  SimStats total;
+  steals_ = 0;
+  for(int w = 0; w < nthreads; ++w) {
+    total.merge(workerStats_[w]);
+    steals_ += steals[w];
+  }
+  return total;
+}
@@ -0,0 +1,76 @@
+//---------------------------------------------------------------------------
+//
+// batch.hpp/batch.cpp
+//
+// Plays a large number of independent games across a pool of worker
+// threads.  Each worker owns its Game and Policy and keeps its own
+// SimStats; the only thing shared while games are running is the queue
+// of game indices, which is split across the workers and rebalanced by
+// stealing.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_BATCH_HPP
+#define CS488_BATCH_HPP
+
+#include <functional>
+#include <vector>
+
+#include "sim.hpp"
+
+struct BatchConfig
+{
+  BatchConfig();
+
+  int width;
+  int height;
+  Game::Randomiser randomiser;
+
+  // Number of games, and the seed that all per-game seeds derive from.
+  // Game i always plays from streamSeed(seed, i), whichever worker
+  // picks it up, so the totals do not depend on the thread count.
+  long games;
+  uint64_t seed;
+
+  // Passed on to playGame.
+  long maxTicks;
+
+  // Worker threads; 0 means one per hardware thread.
+  int threads;
+
+  // Games handed out at a time.  Bigger chunks mean less traffic on the
+  // queues, smaller ones better balance at the end of the run.
+  long chunk;
+};
+
+class BatchRunner
+{
+public:
+  // Called once in each worker to build that worker's policy.
+  typedef std::function<Policy*(int worker)> PolicyFactory;
+
+  BatchRunner(const BatchConfig& config, PolicyFactory factory);
+
+  // Play every game and return the merged counters.
+  SimStats run();
+
+  // Counters of each worker in the last run.
+  const std::vector<SimStats>& getWorkerStats() const
+  {
+    return workerStats_;
+  }
+
+  // How many times a worker ran out of work and took some from another.
+  long getSteals() const
+  {
+    return steals_;
+  }
+
+private:
+  BatchConfig config_;
+  PolicyFactory factory_;
+  std::vector<SimStats> workerStats_;
+  long steals_;
+};
+
+#endif // CS488_BATCH_HPP
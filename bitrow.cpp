@@ -0,0 +1,116 @@
+//---------------------------------------------------------------------------
+//
+// bitrow.hpp/bitrow.cpp
+//
+//---------------------------------------------------------------------------
+
+#include "bitrow.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+static bool fullRowSse2(const uint64_t* words, int n, uint64_t last)
+{
+  const __m128i ones = _mm_set1_epi32(-1);
+  const int body = n - 1;
+  int i = 0;
+  for(; i + 2 <= body; i += 2) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(words + i));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi32(v, ones)) != 0xffff) {
+      return false;
+    }
+  }
+  for(; i < body; ++i) {
+    if(words[i] != ~uint64_t(0)) {
+      return false;
+    }
+  }
+  return words[body] == last;
+}
+
+static bool emptyRowSse2(const uint64_t* words, int n)
+{
+  __m128i any = _mm_setzero_si128();
+  int i = 0;
+  for(; i + 2 <= n; i += 2) {
+    any = _mm_or_si128(any, _mm_loadu_si128((const __m128i*)(words + i)));
+  }
+  if(_mm_movemask_epi8(_mm_cmpeq_epi32(any, _mm_setzero_si128())) != 0xffff) {
+    return false;
+  }
+  return i == n || words[i] == 0;
+}
+
+__attribute__((target("avx2")))
+static bool fullRowAvx2(const uint64_t* words, int n, uint64_t last)
+{
+  const __m256i ones = _mm256_set1_epi64x(-1);
+  const int body = n - 1;
+  int i = 0;
+  for(; i + 4 <= body; i += 4) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(words + i));
+    if(!_mm256_testc_si256(v, ones)) {
+      return false;
+    }
+  }
+  for(; i < body; ++i) {
+    if(words[i] != ~uint64_t(0)) {
+      return false;
+    }
+  }
+  return words[body] == last;
+}
+
+__attribute__((target("avx2")))
+static bool emptyRowAvx2(const uint64_t* words, int n)
+{
+  __m256i any = _mm256_setzero_si256();
+  int i = 0;
+  for(; i + 4 <= n; i += 4) {
+    any = _mm256_or_si256(any, _mm256_loadu_si256((const __m256i*)(words + i)));
+  }
+  if(!_mm256_testz_si256(any, any)) {
+    return false;
+  }
+  for(; i < n; ++i) {
+    if(words[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Worked out before main, so that worker threads only ever read it.
+// Anything run earlier than that gets the SSE2 versions, which are
+// always there.
+static bool hasAvx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+static const bool HAS_AVX2 = hasAvx2();
+
+bool isFullRow(const uint64_t* words, int n, uint64_t last)
+{
+  return HAS_AVX2 ? fullRowAvx2(words, n, last) : fullRowSse2(words, n, last);
+}
+
+bool isEmptyRow(const uint64_t* words, int n)
+{
+  return HAS_AVX2 ? emptyRowAvx2(words, n) : emptyRowSse2(words, n);
+}
+
+#else
+
+bool isFullRow(const uint64_t* words, int n, uint64_t last)
+{
+  return isFullRow<uint64_t>(words, n, last);
+}
+
+bool isEmptyRow(const uint64_t* words, int n)
+{
+  return isEmptyRow<uint64_t>(words, n);
+}
+
+#endif
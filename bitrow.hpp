@@ -0,0 +1,46 @@
+//---------------------------------------------------------------------------
+//
+// bitrow.hpp/bitrow.cpp
+//
+// Tests on the occupancy bitsets of well rows that span several words.
+// The 64-bit versions work a vector of words at a time, with AVX2 when
+// the processor has it and SSE2 otherwise.  Narrower words only ever
+// come one to a row, and get the plain loops.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_BITROW_HPP
+#define CS488_BITROW_HPP
+
+#include <stdint.h>
+
+// Whether a row of n words is full: every word all ones but the last,
+// which must equal last (the bits of it that stand for columns).
+bool isFullRow(const uint64_t* words, int n, uint64_t last);
+
+// Whether a row of n words has no bit set.
+bool isEmptyRow(const uint64_t* words, int n);
+
+template<typename Word>
+inline bool isFullRow(const Word* words, int n, Word last)
+{
+  for(int i = 0; i + 1 < n; ++i) {
+    if(words[i] != Word(~Word(0))) {
+      return false;
+    }
+  }
+  return words[n - 1] == last;
+}
+
+template<typename Word>
+inline bool isEmptyRow(const Word* words, int n)
+{
+  for(int i = 0; i < n; ++i) {
+    if(words[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif // CS488_BITROW_HPP
@@ -13,184 +13,364 @@
 //---------------------------------------------------------------------------
 
 #include <algorithm>
+#include <assert.h>
+#include <stdlib.h>
 
 #include "game.hpp"
+#include "varint.hpp"
 
-static const Piece PIECES[] = {
-  Piece(
+// The seven shapes in their initial orientation.  The index of each
+// shape is also its colour index.
+static constexpr const char* PIECE_DESCS[Piece::NUM_SHAPES] = {
         ".x.."
         ".x.."
         ".x.."
-        ".x..", 0,			1,0,2,0), // Blue
-  Piece(
+        ".x..", // Blue
         "...."
         ".xx."
         ".x.."
-        ".x..", 1,			1,1,1,0), // purple 
-  Piece(
+        ".x..", // purple 
         "...."
         ".xx."
         "..x."
-        "..x.", 2,			1,1,1,0), // orange
-  Piece(
+        "..x.", // orange
         "...."
         ".x.."
         ".xx."
-        "..x.", 3,			1,1,1,0), // green
-  Piece(
+        "..x.", // green
         "...."
         "..x."
         ".xx."
-        ".x..", 4,			1,1,1,0), // red
-  Piece(
+        ".x..", // red
         "...."
         "xxx."
         ".x.."
-        "....", 5,			0,1,1,1), // pink
-  Piece(
+        "....", // pink
         "...."
         ".xx."
         ".xx."
-        "....", 6,			1,1,1,1) // yellow
+        "....", // yellow
 };
 
-Piece::Piece(const char *desc, int cindex, 
-              int left, int top, int right, int bottom)
+static constexpr unsigned short descToMask(const char *desc)
 {
-  std::copy(desc, desc + 16, desc_);
-  cindex_ = cindex;
-  margins_[0] = left;
-  margins_[1] = top;
-  margins_[2] = right;
-  margins_[3] = bottom;
+  unsigned short mask = 0;
+  for(int i = 0; i < 16; ++i) {
+    if(desc[i] == 'x') {
+      mask |= 1 << i;
+    }
+  }
+  return mask;
 }
 
-Piece::Piece()
-{}
-
-Piece& Piece::operator =(const Piece& other)
+// Turn a 4x4 mask a quarter turn clockwise: the new row r is the old
+// column r read from the bottom up.
+static constexpr unsigned short rotateMaskCW(unsigned short mask)
 {
-  std::copy(other.desc_, other.desc_ + 16, desc_);
-  std::copy(other.margins_, other.margins_ + 4, margins_);
-  cindex_ = other.cindex_;
-  return *this;
+  unsigned short rotated = 0;
+  for(int r = 0; r < 4; ++r) {
+    for(int c = 0; c < 4; ++c) {
+      if((mask >> ((3-c)*4 + r)) & 1) {
+        rotated |= 1 << (r*4 + c);
+      }
+    }
+  }
+  return rotated;
 }
 
-int Piece::getLeftMargin() const
+static constexpr PieceOrientation makeOrientation(unsigned short mask)
 {
-  return margins_[0];
+  PieceOrientation o = {};
+  o.mask = mask;
+
+  int left = 3, top = 3, right = 0, bottom = 0;
+  int n = 0;
+  for(int c = 0; c < 4; ++c) {
+    o.bottom[c] = -1;
+  }
+  for(int r = 0; r < 4; ++r) {
+    for(int c = 0; c < 4; ++c) {
+      if((mask >> (r*4 + c)) & 1) {
+        o.rows[r] |= 1 << c;
+        o.cells[n][0] = r;
+        o.cells[n][1] = c;
+        ++n;
+        o.bottom[c] = r;
+        left = std::min(left, c);
+        right = std::max(right, c);
+        top = std::min(top, r);
+        bottom = std::max(bottom, r);
+      }
+    }
+  }
+
+  o.margins[0] = left;
+  o.margins[1] = top;
+  o.margins[2] = 3 - right;
+  o.margins[3] = 3 - bottom;
+  return o;
 }
 
-int Piece::getTopMargin() const
+// The mask moved up and left until it touches the top and left edges.
+static constexpr unsigned short normaliseMask(const PieceOrientation& o)
 {
-  return margins_[1];
+  unsigned short mask = 0;
+  for(int r = o.margins[1]; r < 4; ++r) {
+    mask |= (o.rows[r] >> o.margins[0]) << ((r - o.margins[1]) * 4);
+  }
+  return mask;
 }
 
-int Piece::getRightMargin() const
+static constexpr PieceTable makePieceTable()
 {
-  return margins_[2];
+  PieceTable table = {};
+  for(int s = 0; s < Piece::NUM_SHAPES; ++s) {
+    unsigned short mask = descToMask(PIECE_DESCS[s]);
+    for(int o = 0; o < Piece::NUM_ORIENTATIONS; ++o) {
+      table.orientations[s][o] = makeOrientation(mask);
+      mask = rotateMaskCW(mask);
+    }
+
+    for(int o = 0; o < Piece::NUM_ORIENTATIONS; ++o) {
+      PieceOrientation& orient = table.orientations[s][o];
+      orient.canonical = o;
+      for(int prev = 0; prev < o; ++prev) {
+        if(normaliseMask(table.orientations[s][prev]) == normaliseMask(orient)) {
+          orient.canonical = prev;
+          break;
+        }
+      }
+    }
+  }
+  return table;
 }
 
-int Piece::getBottomMargin() const
+constexpr PieceTable PIECE_TABLE = makePieceTable();
+
+template<int W, int R>
+BasicBoard<W, R>::BasicBoard(int width, int rows)
 {
-  return margins_[3];
+  assert(width > 0);
+  init(width, rows);
 }
 
-int Piece::getColourIndex() const
+template<int W, int R>
+BasicBoard<W, R>::BasicBoard()
 {
-  return cindex_;
+  init(W, R);
 }
 
-Piece Piece::rotateCW() const
+template<int W, int R>
+void BasicBoard<W, R>::init(int width, int rows)
 {
-  char ndesc[16];
-  getColumnRev(0, (char*)ndesc);
-  getColumnRev(1, (char*)(ndesc+4));
-  getColumnRev(2, (char*)(ndesc+8));
-  getColumnRev(3, (char*)(ndesc+12));
+  assert(!W || (width == W && rows == R));
 
-  return Piece(ndesc, cindex_,
-		margins_[3], margins_[0], margins_[1], margins_[2]);
+  width_ = width;
+  rows_ = rows;
+  words_ = (width + WORD_BITS - 1) / WORD_BITS;
+  lastFull_ = fullMask(width);
+  bits_.assign(rows * words_, 0);
+  colours_.assign(width * rows, -1);
+  heights_.assign(width, 0);
+  stale_.assign(words_, 0);
+  unsettled_ = false;
+  filled_ = 0;
+  aggregateHeight_ = 0;
+  bumpiness_ = 0;
 }
 
-Piece Piece::rotateCCW() const
+template<int W, int R>
+void BasicBoard<W, R>::set(int r, int c, int colour)
 {
-  char ndesc[16];
-  getColumn(3, (char*)ndesc);
-  getColumn(2, (char*)(ndesc+4));
-  getColumn(1, (char*)(ndesc+8));
-  getColumn(0, (char*)(ndesc+12));
+  colours_[ r*getWidth() + c ] = colour;
+
+  const int w = c / WORD_BITS;
+  const Row bit = Row(1) << (c % WORD_BITS);
+  Row& word = bits_[ r*getWords() + w ];
+  const bool was = (word & bit) != 0;
 
-  return Piece(ndesc, cindex_,
-		margins_[1], margins_[2], margins_[3], margins_[0]);
+  if(colour == -1) {
+    if(!was) {
+      return;
+    }
+    word &= ~bit;
+    --filled_;
+
+    // Emptying the top cell of a column: the next one down is found
+    // when somebody asks.
+    if(r + 1 == heights_[c]) {
+      stale_[w] |= bit;
+      unsettled_ = true;
+    }
+  } else {
+    if(was) {
+      return;
+    }
+    word |= bit;
+    ++filled_;
+
+    if(r + 1 >= heights_[c]) {
+      setHeight(c, r + 1);
+      stale_[w] &= ~bit;
+    }
+  }
+}
+
+template<int W, int R>
+int BasicBoard<W, R>::getRowFill(int r) const
+{
+  int n = 0;
+  for(int w = 0; w < getWords(); ++w) {
+    n += __builtin_popcountll(bits_[ r*getWords() + w ]);
+  }
+  return n;
 }
 
-bool Piece::isOn(int row, int col) const
+template<int W, int R>
+int BasicBoard<W, R>::nextFilled(int r, int c) const
 {
-  return desc_[ row*4 + col ] == 'x';
+  if(c >= getWidth()) {
+    return getWidth();
+  }
+
+  const Row* row = &bits_[ r*getWords() ];
+  int w = c / WORD_BITS;
+  Row word = row[w] & Row(Row(~Row(0)) << (c % WORD_BITS));
+  while(!word) {
+    if(++w == getWords()) {
+      return getWidth();
+    }
+    word = row[w];
+  }
+  return w * WORD_BITS + __builtin_ctzll(word);
 }
 
-void Piece::getColumn(int col, char *buf) const
+template<int W, int R>
+void BasicBoard<W, R>::settleColumns() const
 {
-  buf[0] = desc_[col];
-  buf[1] = desc_[col+4];
-  buf[2] = desc_[col+8];
-  buf[3] = desc_[col+12];
+  for(int w = 0; w < getWords(); ++w) {
+    while(stale_[w]) {
+      const int b = __builtin_ctzll(stale_[w]);
+      const int c = w * WORD_BITS + b;
+      const Row bit = Row(1) << b;
+
+      int h = heights_[c];
+      while(h > 0 && !(bits_[ (h-1)*getWords() + w ] & bit)) {
+        --h;
+      }
+      setHeight(c, h);
+
+      stale_[w] &= stale_[w] - 1;
+    }
+  }
+  unsettled_ = false;
 }
 
-void Piece::getColumnRev(int col, char *buf) const
+template<int W, int R>
+void BasicBoard<W, R>::setHeight(int c, int height) const
 {
-  buf[0] = desc_[col+12];
-  buf[1] = desc_[col+8];
-  buf[2] = desc_[col+4];
-  buf[3] = desc_[col];
+  const int old = heights_[c];
+  if(c > 0) {
+    bumpiness_ += std::abs(height - heights_[c-1]) - std::abs(old - heights_[c-1]);
+  }
+  if(c + 1 < getWidth()) {
+    bumpiness_ += std::abs(height - heights_[c+1]) - std::abs(old - heights_[c+1]);
+  }
+  aggregateHeight_ += height - old;
+  heights_[c] = height;
 }
 
-Game::Game(int width, int height)
-  : board_width_(width)
-	, board_height_(height)
-	, stopped_(false)
-	, linesCleared_(0)
-	, score_(0)
+// Work out every column height again by walking down from the top row
+// until every column has been seen.  stale_ holds the columns seen so
+// far, and is empty again at the end.
+template<int W, int R>
+void BasicBoard<W, R>::recomputeHeights()
 {
-  int sz = board_width_ * (board_height_+4);
+  std::fill(heights_.begin(), heights_.end(), 0);
+  std::fill(stale_.begin(), stale_.end(), 0);
 
-  board_ = new int[ sz ];
-  std::fill(board_, board_ + sz, -1);
-  generateNewPiece();
+  int unseen = getWidth();
+  for(int r = getRows() - 1; r >= 0 && unseen > 0; --r) {
+    for(int w = 0; w < getWords(); ++w) {
+      const Row bits = bits_[ r*getWords() + w ];
+      Row fresh = bits & ~stale_[w];
+      while(fresh) {
+        int c = w * WORD_BITS + __builtin_ctzll(fresh);
+        heights_[c] = r + 1;
+        --unseen;
+        fresh &= fresh - 1;
+      }
+      stale_[w] |= bits;
+    }
+  }
+  std::fill(stale_.begin(), stale_.end(), 0);
+  unsettled_ = false;
+
+  aggregateHeight_ = 0;
+  bumpiness_ = 0;
+  for(int c = 0; c < getWidth(); ++c) {
+    aggregateHeight_ += heights_[c];
+    if(c > 0) {
+      bumpiness_ += std::abs(heights_[c] - heights_[c-1]);
+    }
+  }
 }
 
-void Game::reset()
+template<int W, int R>
+int BasicBoard<W, R>::getMaxHeight() const
 {
-	stopped_ = false;
-	std::fill(board_, board_ + (board_width_*(board_height_+4)), -1);
-	linesCleared_ = 0;
-	score_ = 0;
-	generateNewPiece();
+  settle();
+  return getWidth() ? *std::max_element(heights_.begin(), heights_.end()) : 0;
+}
+
+// Rows are stored one after another, so a run of them moves as one
+// block of words and one block of colours.
+template<int W, int R>
+void BasicBoard<W, R>::moveRows(int from, int to, int dst)
+{
+  std::copy(bits_.begin() + from*getWords(), bits_.begin() + to*getWords(),
+            bits_.begin() + dst*getWords());
+  std::copy(colours_.begin() + from*getWidth(), colours_.begin() + to*getWidth(),
+            colours_.begin() + dst*getWidth());
 }
 
-Game::~Game()
+template<int W, int R>
+void BasicBoard<W, R>::clearRow(int r)
 {
-  delete [] board_;
+  std::fill(bits_.begin() + r*getWords(), bits_.begin() + (r+1)*getWords(), 0);
+  std::fill(colours_.begin() + r*getWidth(), colours_.begin() + (r+1)*getWidth(), -1);
 }
 
-int Game::get(int r, int c) const
+template<int W, int R>
+void BasicBoard<W, R>::clear()
 {
-  return board_[ r*board_width_ + c ];
+  std::fill(bits_.begin(), bits_.end(), 0);
+  std::fill(colours_.begin(), colours_.end(), -1);
+  std::fill(heights_.begin(), heights_.end(), 0);
+  std::fill(stale_.begin(), stale_.end(), 0);
+  unsettled_ = false;
+  aggregateHeight_ = 0;
+  filled_ = 0;
+  bumpiness_ = 0;
 }
 
-int& Game::get(int r, int c) 
+// Shift the row mask of a piece so that its column 0 lands on column x
+// of a word.  Columns that fall off to the left are always empty, since
+// the margins have been checked.
+template<typename Row>
+static inline Row shiftRowMask(unsigned mask, int x)
 {
-  return board_[ r*board_width_ + c ];
+  return (x >= 0) ? Row(Row(mask) << x) : Row(Row(mask) >> -x);
 }
 
-bool Game::doesPieceFit(const Piece& p, int x, int y) const
+template<int W, int R>
+bool BasicBoard<W, R>::fits(const Piece& p, int x, int y) const
 {
   if(x + p.getLeftMargin() < 0) {
     return false;
   }
 
-  if(x + 3 - p.getRightMargin() >= board_width_) {
+  if(x + 3 - p.getRightMargin() >= getWidth()) {
     return false;
   }
 
@@ -198,286 +378,864 @@ bool Game::doesPieceFit(const Piece& p, int x, int y) const
     return false;
   }
 
-  for(int r = 0; r < 4; ++r) {
-    for(int c = 0; c < 4; ++c) {
-      if(p.isOn(r, c)) {
-        if(get(y-r, x+c) != -1) {
-          return false;
-        }
+  if(getWords() == 1) {
+    for(int r = p.getTopMargin(); r < 4 - p.getBottomMargin(); ++r) {
+      if(bits_[y-r] & shiftRowMask<Row>(p.getRowMask(r), x)) {
+        return false;
       }
     }
+    return true;
+  }
+
+  // The piece's columns may straddle two words of a row.  In the last
+  // word the columns past it are the wall, which the margins have
+  // already ruled out.
+  const int w = (x > 0) ? x / WORD_BITS : 0;
+  const int b = x - w * WORD_BITS;
+  for(int r = p.getTopMargin(); r < 4 - p.getBottomMargin(); ++r) {
+    const Row* row = &bits_[ (y-r)*getWords() + w ];
+    if(row[0] & shiftRowMask<Row>(p.getRowMask(r), b)) {
+      return false;
+    }
+    if(b > WORD_BITS - 4 && w + 1 < getWords() &&
+       (row[1] & Row(p.getRowMask(r) >> (WORD_BITS - b)))) {
+      return false;
+    }
   }
 
   return true;
 }
 
-void Game::removePiece(const Piece& p, int x, int y) 
+template<int W, int R>
+int BasicBoard<W, R>::dropRow(const Piece& p, int x, int y) const
 {
-  for(int r = 0; r < 4; ++r) {
-    for(int c = 0; c < 4; ++c) {
-      if(p.isOn(r, c)) {
-        get(y-r, x+c) = -1;
-      }
+  // Each column of the piece comes to rest on top of the matching
+  // column of the well, or the floor.  If the piece is above all of
+  // those resting rows, every row in between is clear.
+  settle();
+
+  const PieceOrientation& o = p.getOrientation();
+  int land = 3 - o.margins[3];
+  for(int c = 0; c < 4; ++c) {
+    if(o.bottom[c] >= 0) {
+      land = std::max(land, heights_[x+c] + o.bottom[c]);
     }
   }
+  if(land <= y) {
+    return land;
+  }
+
+  // The piece has been slid in under an overhang.
+  while(fits(p, x, y-1)) {
+    --y;
+  }
+  return y;
 }
 
-void Game::removeRow(int y)
+template<int W, int R>
+void BasicBoard<W, R>::place(const Piece& p, int x, int y)
 {
-  for(int r = y + 1; r < board_height_ + 4; ++r) {
-    for(int c = 0; c < board_width_; ++c) {
-      get(r-1, c) = get(r, c);
-    }
+  const PieceOrientation& o = p.getOrientation();
+  for(int i = 0; i < 4; ++i) {
+    set(y - o.cells[i][0], x + o.cells[i][1], p.getColourIndex());
   }
+}
 
-  for(int c = 0; c < board_width_; ++c) {
-    get(board_height_+3, c) = -1;
+template<int W, int R>
+void BasicBoard<W, R>::remove(const Piece& p, int x, int y)
+{
+  const PieceOrientation& o = p.getOrientation();
+  for(int i = 0; i < 4; ++i) {
+    set(y - o.cells[i][0], x + o.cells[i][1], -1);
   }
 }
 
-int Game::collapse() 
+template<int W, int R>
+int BasicBoard<W, R>::collapse(std::vector<int>* cleared)
 {
-  // This method is implemented in a brain-dead way.  Repeatedly
-  // walk up from the bottom of the well, removing the first full 
-  // row, stopping when there are no more full rows.  It could be
-  // made much faster.  Sue me.
-
-  int removed = 0;
+  // No row at or above the shortest column can be full, and nothing
+  // above the tallest needs to move, so on a wide or deep well only the
+  // rows in between are looked at.
+  settle();
+  if(!getWidth()) {
+    return 0;
+  }
+  const std::pair<const int*, const int*> range =
+    std::minmax_element(&heights_[0], &heights_[0] + getWidth());
+  const int low = *range.first;
+  const int used = *range.second;
 
-  while(true) {
-    bool got_one = false;
-    for(int r = 0; r < board_height_ + 4; ++r) {
-      int holes = 0;
+  int r = 0;
+  while(r < low && !isRowFull(r)) {
+    ++r;
+  }
+  if(r == low) {
+    return 0;
+  }
 
-      for(int c = 0; c < board_width_; ++c) {
-        if(get(r, c) == -1) {
-          holes = 1;
-          break;
-        }
+  // From the first full row up, walk the well once.  Full rows are
+  // noted and skipped, and each run of surviving rows is moved down
+  // over the gap left by the full rows beneath it, so the survivors
+  // keep their order.  Rows below the first full one are never touched.
+  int dst = r;
+  while(r < used) {
+    if(r < low && isRowFull(r)) {
+      if(cleared) {
+        cleared->push_back(r);
       }
+      ++r;
+      continue;
+    }
 
-      if(holes == 0) {
-        got_one = 1;
-        ++removed;
-        removeRow(r);
-        break;
-      }
+    int end = r + 1;
+    while(end < low && !isRowFull(end)) {
+      ++end;
     }
+    if(end >= low) {
+      end = used;
+    }
+    moveRows(r, end, dst);
+    dst += end - r;
+    r = end;
+  }
+
+  for(int r = dst; r < used; ++r) {
+    clearRow(r);
+  }
+
+  filled_ -= (used - dst) * getWidth();
+  recomputeHeights();
+
+  return used - dst;
+}
+
+template<typename B>
+SharedBoard<B>::SharedBoard(const B& board)
+{
+  Pool* pool = new Pool;
+  pool->blocks = 0;
+  pool->used = 0;
+  block_ = take(pool, board);
+}
 
-    if(!got_one) {
-      break;
+// A new block of the pool, holding a copy of board, free.
+template<typename B>
+typename SharedBoard<B>::Block* SharedBoard<B>::newBlock(Pool* pool, const B& board)
+{
+  Block* block = new Block(board);
+  block->refs = 0;
+  block->pool = pool;
+  ++pool->blocks;
+  pool->free.reserve(pool->blocks);
+  return block;
+}
+
+// A block of the pool holding a copy of board, with one holder.  A free
+// block is reused before a new one is made.
+template<typename B>
+typename SharedBoard<B>::Block* SharedBoard<B>::take(Pool* pool, const B& board)
+{
+  Block* block;
+  if(pool->free.empty()) {
+    block = newBlock(pool, board);
+  } else {
+    block = pool->free.back();
+    pool->free.pop_back();
+    block->board = board;
+  }
+  block->refs = 1;
+  ++pool->used;
+  return block;
+}
+
+template<typename B>
+void SharedBoard<B>::unshare()
+{
+  Block* shared = block_;
+  block_ = take(shared->pool, shared->board);
+  --shared->refs;
+}
+
+template<typename B>
+void SharedBoard<B>::release()
+{
+  Block* block = block_;
+  block_ = 0;
+  if(!block || --block->refs > 0) {
+    return;
+  }
+
+  Pool* pool = block->pool;
+  pool->free.push_back(block);
+  if(--pool->used == 0) {
+    for(size_t i = 0; i < pool->free.size(); ++i) {
+      delete pool->free[i];
     }
+    delete pool;
   }
+}
 
-  return removed;
+template<typename B>
+void SharedBoard<B>::reserve(int count)
+{
+  Pool* pool = block_->pool;
+  while(int(pool->free.size()) < count) {
+    pool->free.push_back(newBlock(pool, block_->board));
+  }
 }
 
-void Game::placePiece(const Piece& p, int x, int y)
+ChangeSet::ChangeSet()
+  : spawned(0)
+  , gameOver(false)
+  , everything(false)
+{}
+
+void ChangeSet::clear()
 {
-  for(int r = 0; r < 4; ++r) {
-    for(int c = 0; c < 4; ++c) {
-      if(p.isOn(r, c)) {
-        get(y-r, x+c) = p.getColourIndex();
-      }
+  cells.clear();
+  clearedRows.clear();
+  spawned = 0;
+  gameOver = false;
+  everything = false;
+}
+
+bool ChangeSet::empty() const
+{
+  return cells.empty() && clearedRows.empty() && spawned == 0
+    && !gameOver && !everything;
+}
+
+template<int W, int H>
+BasicGame<W, H>::BasicGame(int width, int height, uint64_t seed)
+  : board_width_(width)
+	, board_height_(height)
+	, stopped_(false)
+	, board_(BoardType(width, height+4))
+	, rng_(seed)
+	, seed_(seed)
+	, randomiser_(UNIFORM)
+	, bagLeft_(0)
+	, previewHead_(0)
+	, previewLength_(1)
+	, journal_(false)
+	, score_(0)
+	, linesCleared_(0)
+	, pieceCount_(0)
+{
+  // A piece spans four rows, so no lock clears more
+  clearedRows_.reserve(4);
+  fillPreview();
+  generateNewPiece();
+}
+
+template<int W, int H>
+void BasicGame<W, H>::reset()
+{
+	stopped_ = false;
+	board_.write().clear();
+	clearedRows_.clear();
+	linesCleared_ = 0;
+	score_ = 0;
+	pieceCount_ = 0;
+	bagLeft_ = 0;
+	fillPreview();
+	generateNewPiece();
+
+	if(journal_)
+		changes_.everything = true;
+}
+
+template<int W, int H>
+void BasicGame<W, H>::reset(uint64_t seed)
+{
+	seed_ = seed;
+	rng_.setSeed(seed);
+	reset();
+}
+
+template<int W, int H>
+void BasicGame<W, H>::setJournalEnabled(bool enabled)
+{
+	journal_ = enabled;
+	changes_.clear();
+}
+
+template<int W, int H>
+void BasicGame<W, H>::setRandomiser(Randomiser randomiser)
+{
+	randomiser_ = randomiser;
+}
+
+template<int W, int H>
+void BasicGame<W, H>::setPreviewLength(int length)
+{
+	length = std::max(1, std::min(length, int(MAX_PREVIEW)));
+
+	// Keep the pieces already promised, and draw any new ones needed.
+	int upcoming[MAX_PREVIEW];
+	for(int i = 0; i < length; ++i) {
+		upcoming[i] = (i < previewLength_) ? getPreview(i) : drawShape();
+	}
+
+	std::copy(upcoming, upcoming + length, preview_);
+	previewHead_ = 0;
+	previewLength_ = length;
+}
+
+template<int W, int H>
+BasicGame<W, H>::~BasicGame()
+{
+}
+
+// Whether piece p with its box at (x, y) fills the cell at row r,
+// column c.
+template<int W, int H>
+bool BasicGame<W, H>::covers(const Piece& p, int x, int y, int r, int c) const
+{
+  int pr = y - r;
+  int pc = c - x;
+  return pr >= 0 && pr < 4 && pc >= 0 && pc < 4 && p.isOn(pr, pc);
+}
+
+template<int W, int H>
+int BasicGame<W, H>::get(int r, int c) const
+{
+  if(!stopped_ && covers(piece_, px_, py_, r, c)) {
+    return piece_.getColourIndex();
+  }
+  return board_->get(r, c);
+}
+
+template<int W, int H>
+typename BasicGame<W, H>::Layer BasicGame<W, H>::getLayer(int r, int c) const
+{
+  if(!stopped_ && covers(piece_, px_, py_, r, c)) {
+    return LAYER_ACTIVE;
+  }
+  if(board_->get(r, c) != -1) {
+    return LAYER_LOCKED;
+  }
+  if(!stopped_ && covers(piece_, px_, gy_, r, c)) {
+    return LAYER_GHOST;
+  }
+  return LAYER_EMPTY;
+}
+
+template<int W, int H>
+bool BasicGame<W, H>::doesPieceFit(const Piece& p, int x, int y) const
+{
+  return board_->fits(p, x, y);
+}
+
+template<int W, int H>
+int BasicGame<W, H>::collapse() 
+{
+  clearedRows_.clear();
+  return board_.write().collapse(&clearedRows_);
+}
+
+template<int W, int H>
+int BasicGame<W, H>::drawShape()
+{
+  if(randomiser_ == UNIFORM) {
+    return rng_.below(Piece::NUM_SHAPES);
+  }
+
+  if(bagLeft_ == 0) {
+    // Refill the bag and shuffle it (Fisher-Yates).
+    for(int i = 0; i < Piece::NUM_SHAPES; ++i) {
+      bag_[i] = i;
     }
+    for(int i = Piece::NUM_SHAPES - 1; i > 0; --i) {
+      std::swap(bag_[i], bag_[rng_.below(i + 1)]);
+    }
+    bagLeft_ = Piece::NUM_SHAPES;
   }
-//dropShadowPiece();
+
+  return bag_[--bagLeft_];
 }
-	
-void Game::generateNewPiece() 
+
+template<int W, int H>
+void BasicGame<W, H>::fillPreview()
 {
-  piece_ = PIECES[ rand() % 7 ];
+  previewHead_ = 0;
+  for(int i = 0; i < previewLength_; ++i) {
+    preview_[i] = drawShape();
+  }
+}
 
-  int xleft = (board_width_-3) / 2;
+template<int W, int H>
+void BasicGame<W, H>::generateNewPiece() 
+{
+  // Take the head of the preview ring, and refill its slot with a new
+  // shape, which now becomes the last one in the preview.
+  piece_ = Piece(preview_[previewHead_], 0);
+  preview_[previewHead_] = drawShape();
+  previewHead_ = (previewHead_ + 1) % previewLength_;
+  ++pieceCount_;
+
+  int xleft = (getWidth()-3) / 2;
 
   px_ = xleft;
-  py_ = board_height_ + 3 - piece_.getBottomMargin();
+  py_ = getHeight() + 3 - piece_.getBottomMargin();
+
+  dropShadowPiece();
 
-	shadowPiece_ = piece_;
-	sx_ = px_;
-	sy_ = py_;
-	
-  placePiece(piece_, px_, py_);
+  if(journal_) {
+    ++changes_.spawned;
+    journalFallingPiece();
+  }
 }
 
-int Game::tick()
+template<int W, int H>
+int BasicGame<W, H>::lockPiece()
 {
-	if(stopped_) 
+	// Write the falling piece into the well for good.
+	journalFallingPiece();
+	board_.write().place(piece_, px_, py_);
+
+	if(py_ >= getHeight()) 
 	{
+		// you lose.
+		stopped_ = true;
+		if(journal_)
+			changes_.gameOver = true;
 		return -1;
+	} 
+
+	int rm = collapse();
+	if(journal_)
+		changes_.clearedRows.insert(changes_.clearedRows.end(),
+		                            clearedRows_.begin(), clearedRows_.end());
+	int level = 1 + linesCleared_ / 10;
+	switch (rm)
+	{
+		case 0:
+			score_ += 10 * level;
+			break;
+		case 1:
+			score_ += rm * 100 * level;
+			break;
+		case 2:
+		 	score_ += rm * 300 * level;
+			break;
+		case 3:
+		 	score_ += rm * 500 * level;
+			break;
+		case 4:
+		 	score_ += rm * 800 * level;
+			break;
 	}
+	linesCleared_ += rm;
+	generateNewPiece();
+	return rm;
+}
 
-	removePiece(piece_, px_, py_);
-	int ny = py_ - 1;
+template<int W, int H>
+int BasicGame<W, H>::tick()
+{
+	if(stopped_) 
+	{
+		return -1;
+	}
 
-	if(!doesPieceFit(piece_, px_, ny)) 
+	if(!doesPieceFit(piece_, px_, py_ - 1)) 
 	{
 		// Must finish off with this piece
-		placePiece(piece_, px_, py_);
-		if(py_ >= board_height_) 
-		{
-	    	// you lose.
-	    	stopped_ = true;
-	    	return -1;
-		} 
-		else
-		{
-	    	int rm = collapse();
-			int level = 1 + linesCleared_ / 10;
-			switch (rm)
-			{
-				case 0:
-					score_ += 10 * level;
-					break;
-				case 1:
-					score_ += rm * 100 * level;
-					break;
-				case 2:
-				 	score_ += rm * 300 * level;
-					break;
-				case 3:
-				 	score_ += rm * 500 * level;
-					break;
-				case 4:
-				 	score_ += rm * 800 * level;
-					break;
-			}
-			linesCleared_ += rm;
-	    	generateNewPiece();
-	    	return rm;
-		}
+		return lockPiece();
 	}
-	else 
+
+	if(journal_)
+		journalPiece(piece_, px_, py_);
+	--py_;
+	if(journal_)
+		journalPiece(piece_, px_, py_);
+	return 0;
+}
+
+template<int W, int H>
+void BasicGame<W, H>::getPlacements(std::vector<PlacementType>& out) const
+{
+	size_t n = 0;
+	for(int o = 0; o < Piece::NUM_ORIENTATIONS; ++o)
 	{
-		placePiece(piece_, px_, ny);
-		py_ = ny;
-		return 0;
+		Piece p(piece_.getShape(), o);
+		if(p.getOrientation().canonical != o)
+			continue;
+
+		for(int x = -p.getLeftMargin(); x + 3 - p.getRightMargin() < getWidth(); ++x)
+		{
+			if(!board_->fits(p, x, py_))
+				continue;
+
+			if(n == out.size())
+				out.push_back(PlacementType());
+
+			PlacementType& pl = out[n++];
+			pl.piece = p;
+			pl.x = x;
+			pl.y = board_->dropRow(p, x, py_);
+			pl.board = *board_;
+			pl.board.place(p, pl.x, pl.y);
+			pl.linesCleared = pl.board.collapse();
+		}
 	}
+
+	out.resize(n);
 }
 
-bool Game::moveLeft()
+template<int W, int H>
+int BasicGame<W, H>::applyPlacement(const PlacementType& placement)
 {
-  // Most of the piece movement methods work like this:
-  //  1. remove the piece from the board.
-  // 	2. does the piece fit in its new configuration?
-  //	3a. if yes, add it to the board in its new configuration.
-  //	3b. if no, put it back where it was.
-  // Simple and sort of silly, but satisfactory.
+	if(stopped_)
+		return -1;
 
-  int nx = px_ - 1;
+	journalFallingPiece();
+	piece_ = placement.piece;
+	px_ = placement.x;
+	py_ = placement.y;
+	return lockPiece();
+}
 
-  removePiece(piece_, px_, py_);
-  if(doesPieceFit(piece_, nx, py_)) {
-    placePiece(piece_, nx, py_);
-    px_ = nx;
-    return true;
-  } else {
-    placePiece(piece_, px_, py_);
-    return false;
-  }
+// Most of the piece movement methods work like this: if the piece fits
+// in its new configuration, take it; otherwise nothing changes.  The
+// well is never written to, since the falling piece lives outside it.
+template<int W, int H>
+bool BasicGame<W, H>::tryMove(const Piece& p, int x, int y)
+{
+	if(stopped_ || !doesPieceFit(p, x, y))
+		return false;
+
+	bool sameColumns = (x == px_ && p.getOrientationIndex() == piece_.getOrientationIndex());
+	journalFallingPiece();
+	piece_ = p;
+	px_ = x;
+	py_ = y;
+	if(!sameColumns)
+		dropShadowPiece();
+	journalFallingPiece();
+	return true;
 }
 
-bool Game::moveRight()
+template<int W, int H>
+void BasicGame<W, H>::journalPiece(const Piece& p, int x, int y)
 {
-  int nx = px_ + 1;
+	const PieceOrientation& o = p.getOrientation();
+	for(int i = 0; i < 4; ++i)
+	{
+		ChangeSet::Cell cell = { short(y - o.cells[i][0]), short(x + o.cells[i][1]) };
+		changes_.cells.push_back(cell);
+	}
+}
 
-  removePiece(piece_, px_, py_);
-  if(doesPieceFit(piece_, nx, py_)) {
-    placePiece(piece_, nx, py_);
-    px_ = nx;
-    return true;
-  } else {
-    placePiece(piece_, px_, py_);
-    return false;
-  }
+// Note the cells of the falling piece and of its ghost.  Called on both
+// sides of a change, so that both where it was and where it is now get
+// redrawn.
+template<int W, int H>
+void BasicGame<W, H>::journalFallingPiece()
+{
+	if(!journal_)
+		return;
+
+	journalPiece(piece_, px_, py_);
+	if(gy_ != py_)
+		journalPiece(piece_, px_, gy_);
 }
 
-bool Game::drop()
+template<int W, int H>
+bool BasicGame<W, H>::moveLeft()
 {
-  removePiece(piece_, px_, py_);
-  int ny = py_;
+	return tryMove(piece_, px_ - 1, py_);
+}
 
-  while(true) {
-    --ny;
-	score_ += 1 + (linesCleared_ / 10);
-    if(!doesPieceFit(piece_, px_, ny)) {
-      break;
-    }
+template<int W, int H>
+bool BasicGame<W, H>::moveRight()
+{
+	return tryMove(piece_, px_ + 1, py_);
+}
+
+template<int W, int H>
+bool BasicGame<W, H>::drop()
+{
+  if(stopped_) {
+    return false;
   }
 
-  ++ny;
-  placePiece(piece_, px_, ny);
+  int ny = board_->dropRow(piece_, px_, py_);
+
+  // One point per level for every row tested on the way down, including
+  // the one the piece could not move into.
+  score_ += (py_ - ny + 1) * (1 + (linesCleared_ / 10));
 
   if(ny == py_) {
     return false;
   } else {
+    journalFallingPiece();
     py_ = ny;
+    journalFallingPiece();
     return true;
   }
 }
 
-bool Game::rotateCW() 
+template<int W, int H>
+bool BasicGame<W, H>::rotateCW() 
 {
-	removePiece(piece_, px_, py_);
-	//removePiece(shadowPiece_, sx_, sy_);
-	Piece npiece = piece_.rotateCW();
+	return tryMove(piece_.rotateCW(), px_, py_);
+}
 
-	if(doesPieceFit(npiece, px_, py_)) 
-	{
-		shadowPiece_ = npiece;
-		placePiece(npiece, px_, py_);
-		piece_ = npiece;
-		return true;
-	} 
-	else 
-	{
-		placePiece(piece_, px_, py_);
-		return false;
-	}
+template<int W, int H>
+bool BasicGame<W, H>::rotateCCW() 
+{
+	return tryMove(piece_.rotateCCW(), px_, py_);
 }
 
-bool Game::rotateCCW() 
+template<int W, int H>
+void BasicGame<W, H>::dropShadowPiece()
 {
-	removePiece(piece_, px_, py_);
-//	removePiece(shadowPiece_, sx_, sy_);
-	Piece npiece = piece_.rotateCCW();
-	if(doesPieceFit(npiece, px_, py_)) 
-	{
-		shadowPiece_ = npiece;
-		placePiece(npiece, px_, py_);
-		piece_ = npiece;
-		return true;
-	} 
-	else 
-	{
-		placePiece(piece_, px_, py_);
-		return false;
-	}
+	gy_ = board_->dropRow(piece_, px_, py_);
 }
 
-void Game::dropShadowPiece()
+template<int W, int H>
+void BasicGame<W, H>::saveState(std::vector<unsigned char>& out) const
 {
-	removePiece(shadowPiece_, sx_, sy_);
-	int ny = sy_;
-	sx_ = px_;
-	while(true) 
-	{
-		--ny;
-		if(!doesPieceFit(shadowPiece_, sx_, ny))
-		  break;
-	}
+  putVarint(out, getWidth());
+  putVarint(out, getHeight());
+  putVarint(out, stopped_);
+  putVarint(out, piece_.getShape());
+  putVarint(out, piece_.getOrientationIndex());
+  putSignedVarint(out, px_);
+  putSignedVarint(out, py_);
 
-	++ny;
+  uint64_t state[4];
+  rng_.getState(state);
+  for(int i = 0; i < 4; ++i) {
+    putVarint(out, state[i]);
+  }
+  putVarint(out, seed_);
+  putVarint(out, randomiser_);
+  putVarint(out, bagLeft_);
+  for(int i = 0; i < bagLeft_; ++i) {
+    putVarint(out, bag_[i]);
+  }
+  putVarint(out, previewLength_);
+  for(int i = 0; i < previewLength_; ++i) {
+    putVarint(out, getPreview(i));
+  }
 
-	for(int r = 0; r < 4; ++r) 
-	{
-		for(int c = 0; c < 4; ++c) 
-		{
-			if(shadowPiece_.isOn(r, c))
-				get(ny-r, sx_+c) = shadowPiece_.getColourIndex();
-		}
-	}
+  putVarint(out, score_);
+  putVarint(out, linesCleared_);
+  putVarint(out, pieceCount_);
+
+  // Rows up to the highest filled one, each as its occupancy mask in
+  // 64-column words and then the colours of its filled cells, two to a
+  // byte.
+  int rows = board_->getRows();
+  while(rows > 0 && board_->isRowEmpty(rows - 1)) {
+    --rows;
+  }
+  putVarint(out, rows);
+  for(int r = 0; r < rows; ++r) {
+    for(int c = 0; c < getWidth(); c += 64) {
+      uint64_t bits = 0;
+      for(int k = c; k < getWidth() && k < c + 64; k = board_->nextFilled(r, k + 1)) {
+        if(board_->get(r, k) != -1) {
+          bits |= uint64_t(1) << (k - c);
+        }
+      }
+      putVarint(out, bits);
+    }
+
+    int half = -1;
+    for(int c = board_->nextFilled(r, 0); c < getWidth(); c = board_->nextFilled(r, c + 1)) {
+      if(half < 0) {
+        half = board_->get(r, c);
+      } else {
+        out.push_back((unsigned char)(half | (board_->get(r, c) << 4)));
+        half = -1;
+      }
+    }
+    if(half >= 0) {
+      out.push_back((unsigned char)half);
+    }
+  }
+}
+
+template<int W, int H>
+bool BasicGame<W, H>::loadState(const unsigned char*& p, const unsigned char* end)
+{
+  const unsigned char* q = p;
+  uint64_t v[12];
+  int64_t px, py;
+
+  // Width, height, stopped, shape, orientation
+  for(int i = 0; i < 5; ++i) {
+    if(!getVarint(q, end, v[i])) {
+      return false;
+    }
+  }
+  if(int(v[0]) != getWidth() || int(v[1]) != getHeight() ||
+     v[3] >= Piece::NUM_SHAPES || v[4] >= Piece::NUM_ORIENTATIONS) {
+    return false;
+  }
+  if(!getSignedVarint(q, end, px) || !getSignedVarint(q, end, py)) {
+    return false;
+  }
+
+  uint64_t state[4];
+  for(int i = 0; i < 4; ++i) {
+    if(!getVarint(q, end, state[i])) {
+      return false;
+    }
+  }
+
+  // Seed, randomiser, bag
+  int bag[Piece::NUM_SHAPES];
+  for(int i = 5; i < 8; ++i) {
+    if(!getVarint(q, end, v[i])) {
+      return false;
+    }
+  }
+  if(v[6] > BAG7 || v[7] > Piece::NUM_SHAPES) {
+    return false;
+  }
+  for(int i = 0; i < int(v[7]); ++i) {
+    uint64_t shape;
+    if(!getVarint(q, end, shape) || shape >= Piece::NUM_SHAPES) {
+      return false;
+    }
+    bag[i] = int(shape);
+  }
+
+  // Preview
+  int preview[MAX_PREVIEW];
+  if(!getVarint(q, end, v[8]) || v[8] < 1 || v[8] > MAX_PREVIEW) {
+    return false;
+  }
+  for(int i = 0; i < int(v[8]); ++i) {
+    uint64_t shape;
+    if(!getVarint(q, end, shape) || shape >= Piece::NUM_SHAPES) {
+      return false;
+    }
+    preview[i] = int(shape);
+  }
+
+  // Score, lines, pieces
+  for(int i = 9; i < 12; ++i) {
+    if(!getVarint(q, end, v[i])) {
+      return false;
+    }
+  }
+
+  BoardType board(getWidth(), getHeight() + 4);
+  uint64_t rows;
+  if(!getVarint(q, end, rows) || rows > uint64_t(board.getRows())) {
+    return false;
+  }
+  std::vector<uint64_t> bits((getWidth() + 63) / 64);
+  for(int r = 0; r < int(rows); ++r) {
+    for(size_t w = 0; w < bits.size(); ++w) {
+      int columns = std::min(64, getWidth() - int(w) * 64);
+      if(!getVarint(q, end, bits[w]) || (columns < 64 && (bits[w] >> columns) != 0)) {
+        return false;
+      }
+    }
+
+    int half = 0;
+    for(int c = 0; c < getWidth(); ++c) {
+      if(!((bits[c / 64] >> (c % 64)) & 1)) {
+        continue;
+      }
+      if(q >= end) {
+        return false;
+      }
+      int colour = (*q >> (half * 4)) & 0xf;
+      if(colour >= Piece::NUM_SHAPES) {
+        return false;
+      }
+      board.set(r, c, colour);
+      if(++half == 2) {
+        half = 0;
+        ++q;
+      }
+    }
+    if(half) {
+      ++q;
+    }
+  }
 
-	if(ny != sy_)
-	  sy_ = ny;
+  // Everything checked out; take it.
+  stopped_ = v[2] != 0;
+  piece_ = Piece(int(v[3]), int(v[4]));
+  px_ = int(px);
+  py_ = int(py);
+  rng_.setState(state);
+  seed_ = v[5];
+  randomiser_ = Randomiser(v[6]);
+  bagLeft_ = int(v[7]);
+  std::copy(bag, bag + bagLeft_, bag_);
+  previewLength_ = int(v[8]);
+  previewHead_ = 0;
+  std::copy(preview, preview + previewLength_, preview_);
+  score_ = int(v[9]);
+  linesCleared_ = int(v[10]);
+  pieceCount_ = int(v[11]);
+  board_.write() = board;
+  clearedRows_.clear();
+  dropShadowPiece();
+
+  if(journal_) {
+    changes_.everything = true;
+  }
+  p = q;
+  return true;
 }
+
+template<int W, int H>
+template<typename To, typename From>
+void BasicGame<W, H>::copyState(To& to, const From& from)
+{
+  to.board_width_ = from.board_width_;
+  to.board_height_ = from.board_height_;
+  to.stopped_ = from.stopped_;
+  to.piece_ = from.piece_;
+  to.px_ = from.px_;
+  to.py_ = from.py_;
+  to.gy_ = from.gy_;
+  to.board_ = from.board_;
+  to.clearedRows_ = from.clearedRows_;
+  to.rng_ = from.rng_;
+  to.seed_ = from.seed_;
+  to.randomiser_ = from.randomiser_;
+  std::copy(from.bag_, from.bag_ + Piece::NUM_SHAPES, to.bag_);
+  to.bagLeft_ = from.bagLeft_;
+  std::copy(from.preview_, from.preview_ + MAX_PREVIEW, to.preview_);
+  to.previewHead_ = from.previewHead_;
+  to.previewLength_ = from.previewLength_;
+  to.score_ = from.score_;
+  to.linesCleared_ = from.linesCleared_;
+  to.pieceCount_ = from.pieceCount_;
+}
+
+template<int W, int H>
+void BasicGame<W, H>::takeSnapshot(Snapshot& out) const
+{
+  copyState(out, *this);
+}
+
+template<int W, int H>
+void BasicGame<W, H>::restore(const Snapshot& snapshot)
+{
+  assert(snapshot.board_width_ == board_width_ && snapshot.board_height_ == board_height_);
+  copyState(*this, snapshot);
+
+  if(journal_) {
+    changes_.everything = true;
+  }
+}
+
+template class BasicBoard<0, 0>;
+template class SharedBoard<BasicBoard<0, 0> >;
+template class BasicGame<0, 0>;
+template class BasicBoard<10, 24>;
+template class SharedBoard<BasicBoard<10, 24> >;
+template class BasicGame<10, 20>;
@@ -15,49 +15,611 @@
 #ifndef CS488_GAME_HPP
 #define CS488_GAME_HPP
 
+#include <algorithm>
 #include <iostream>
+#include <type_traits>
+#include <vector>
+#include <stdint.h>
 
+#include "bitrow.hpp"
+#include "random.hpp"
+
+// Everything about one orientation of a piece, worked out at compile
+// time from its 4x4 description.  The cell in row r and column c of the
+// description is bit r*4+c of mask.  Rows are numbered from the top, so
+// a piece anchored at board row y has its row r in board row y-r.
+struct PieceOrientation
+{
+  unsigned short mask;
+  // Bitmask of each row, bit c standing for column c.
+  unsigned char rows[4];
+  // Empty columns/rows on the left, top, right and bottom.
+  signed char margins[4];
+  // (row, col) of each of the four filled cells.
+  signed char cells[4][2];
+  // For each column, the lowest filled row, or -1 if the column is empty.
+  signed char bottom[4];
+  // The first orientation of the same shape that covers the same cells
+  // once moved into the top left corner.  An orientation is only worth
+  // trying in a search if this is its own index.
+  signed char canonical;
+};
+
+struct PieceTable
+{
+  PieceOrientation orientations[7][4];
+};
+
+extern const PieceTable PIECE_TABLE;
+
+// A piece is a shape and one of its four orientations.  Rotating moves
+// to the next orientation in the table; nothing is computed at run time.
 class Piece {
 public:
-  Piece();
-  Piece(const char *desc, int cindex, 
-         int left, int top, int right, int bottom);
+  enum {
+    NUM_SHAPES = 7,
+    NUM_ORIENTATIONS = 4
+  };
+
+  Piece()
+    : shape_(0)
+    , orientation_(0)
+  {}
+  Piece(int shape, int orientation)
+    : shape_(shape)
+    , orientation_(orientation)
+  {}
+
+  const PieceOrientation& getOrientation() const
+  {
+    return PIECE_TABLE.orientations[shape_][orientation_];
+  }
+
+  int getShape() const
+  {
+    return shape_;
+  }
+  int getOrientationIndex() const
+  {
+    return orientation_;
+  }
+
+  int getLeftMargin() const
+  {
+    return getOrientation().margins[0];
+  }
+  int getTopMargin() const
+  {
+    return getOrientation().margins[1];
+  }
+  int getRightMargin() const
+  {
+    return getOrientation().margins[2];
+  }
+  int getBottomMargin() const
+  {
+    return getOrientation().margins[3];
+  }
+  // Each shape has its own colour.
+  int getColourIndex() const
+  {
+    return shape_;
+  }
+
+  Piece rotateCW() const
+  {
+    return Piece(shape_, (orientation_ + 1) % NUM_ORIENTATIONS);
+  }
+  Piece rotateCCW() const
+  {
+    return Piece(shape_, (orientation_ + NUM_ORIENTATIONS - 1) % NUM_ORIENTATIONS);
+  }
+
+  bool isOn(int row, int col) const
+  {
+    return (getOrientation().mask >> (row*4 + col)) & 1;
+  }
+
+  // The cells of one row of the piece as a bitmask, bit c standing for
+  // column c.
+  unsigned getRowMask(int row) const
+  {
+    return getOrientation().rows[row];
+  }
+
+private:
+  unsigned char shape_;
+  unsigned char orientation_;
+};
+
+// The narrowest unsigned word with a bit for each of W columns.  Wells
+// sized at run time (W of 0), and wells too wide for one word, use
+// 64-bit words.
+template<int W>
+struct RowWord
+{
+  typedef typename std::conditional<(W > 0 && W <= 8), uint8_t,
+          typename std::conditional<(W > 0 && W <= 16), uint16_t,
+          typename std::conditional<(W > 0 && W <= 32), uint32_t,
+                                    uint64_t>::type>::type>::type type;
+};
+
+// N cells held in place, or, when N is 0, a vector sized at run time.
+template<typename T, int N>
+class CellArray
+{
+public:
+  CellArray()
+  {}
+
+  // Each array is copied on its own.  Copied as one block a whole board
+  // is big enough for the compiler to use a string move, which is much
+  // slower at this size than the unrolled copy it makes for one array.
+  CellArray(const CellArray& other)
+  {
+    *this = other;
+  }
+  CellArray& operator=(const CellArray& other)
+  {
+    for(int i = 0; i < N; ++i) {
+      data_[i] = other.data_[i];
+    }
+    return *this;
+  }
+
+  void assign(size_t, const T& value)
+  {
+    std::fill(data_, data_ + N, value);
+  }
+
+  T& operator[](size_t i)
+  {
+    return data_[i];
+  }
+  const T& operator[](size_t i) const
+  {
+    return data_[i];
+  }
+
+  T* begin()
+  {
+    return data_;
+  }
+  T* end()
+  {
+    return data_ + N;
+  }
+  const T* begin() const
+  {
+    return data_;
+  }
+  const T* end() const
+  {
+    return data_ + N;
+  }
+
+private:
+  T data_[N];
+};
+
+template<typename T>
+class CellArray<T, 0> : public std::vector<T>
+{};
+
+// The cells of a well.  Occupancy is kept as a bitset per row (bit c
+// is set when column c is filled), so fit tests, full-row checks and row
+// shifts are a few mask operations.  Rows wider than one word take as
+// many words as they need, and full and empty rows are found a vector
+// of words at a time (see bitrow.hpp), so the cost of a line check
+// grows with the number of words, not cells.  Colours live in a
+// separate byte plane that is only touched when cells are written.
+//
+// The board also keeps the shape of its surface up to date as cells
+// change: the height of every column, and from those the hole count and
+// bumpiness, so that evaluators can read them without a scan.  Emptying
+// the top cell of a column only marks the column as needing a look; the
+// next read of a metric settles it, so a piece that is lifted out and
+// put straight back one row lower costs no scan at all.
+//
+// W and R are the width and the number of rows.  When they are known at
+// compile time the row word is the narrowest that holds a row, the cells
+// are kept in the board itself, and every loop over columns or rows has
+// a constant bound.  When both are 0 the size is given to the
+// constructor instead; Board is that kind.
+template<int W, int R>
+class BasicBoard
+{
+  static_assert((W == 0) == (R == 0), "give both dimensions or neither");
+
+public:
+  typedef typename RowWord<W>::type Row;
+
+  enum {
+    // Columns in each word of a row, and words in a row when the width
+    // is fixed.
+    WORD_BITS = sizeof(Row) * 8,
+    WORDS = (W + WORD_BITS - 1) / WORD_BITS
+  };
+
+  // A board of fixed size must be given its own dimensions.
+  BasicBoard(int width, int rows);
+  BasicBoard();
+
+  int getWidth() const
+  {
+    return W ? W : width_;
+  }
+  int getRows() const
+  {
+    return R ? R : rows_;
+  }
+  int getWords() const
+  {
+    return W ? int(WORDS) : words_;
+  }
+
+  // -1 for an empty cell, the colour index otherwise.
+  int get(int r, int c) const
+  {
+    return colours_[ r*getWidth() + c ];
+  }
+  void set(int r, int c, int colour);
+
+  // Word w of row r.  Bit b of it stands for column w*WORD_BITS + b.
+  Row getRowWord(int r, int w) const
+  {
+    return bits_[ r*getWords() + w ];
+  }
+  bool isRowFull(int r) const
+  {
+    if(getWords() == 1) {
+      return bits_[ r ] == getLastFull();
+    }
+    return isFullRow(&bits_[ r*getWords() ], getWords(), getLastFull());
+  }
+  bool isRowEmpty(int r) const
+  {
+    if(getWords() == 1) {
+      return bits_[ r ] == 0;
+    }
+    return isEmptyRow(&bits_[ r*getWords() ], getWords());
+  }
+  int getRowFill(int r) const;
+
+  // The first filled column of row r from column c on, or the width if
+  // there is none.  Empty stretches are skipped a word at a time.
+  int nextFilled(int r, int c) const;
+
+  // One more than the row of the highest filled cell in column c, or 0
+  // if the column is empty.
+  int getColumnHeight(int c) const
+  {
+    settle();
+    return heights_[ c ];
+  }
+  // Sum of all column heights.
+  int getAggregateHeight() const
+  {
+    settle();
+    return aggregateHeight_;
+  }
+  int getFilledCells() const
+  {
+    return filled_;
+  }
+  // Empty cells with a filled cell somewhere above them in the same
+  // column.
+  int getHoles() const
+  {
+    settle();
+    return aggregateHeight_ - filled_;
+  }
+  // Sum of the height differences between neighbouring columns.
+  int getBumpiness() const
+  {
+    settle();
+    return bumpiness_;
+  }
+  int getMaxHeight() const;
+
+  void clear();
+
+  // Whether piece p can sit with its 4x4 box's top left corner at
+  // column x, row y (rows count up from the bottom of the well).
+  bool fits(const Piece& p, int x, int y) const;
+
+  // The lowest row the piece reaches falling straight down from row y,
+  // where it must already fit.  When the piece starts above the surface
+  // this is read off the column heights in time proportional to the
+  // piece width.
+  int dropRow(const Piece& p, int x, int y) const;
+
+  // Write the cells of piece p into the board, or empty them.
+  void place(const Piece& p, int x, int y);
+  void remove(const Piece& p, int x, int y);
+
+  // Remove every full row and move the rows above down.  Returns the
+  // number of rows removed; their indices are appended to cleared,
+  // bottom to top, if it is given.
+  int collapse(std::vector<int>* cleared = 0);
+
+private:
+  void init(int width, int rows);
+
+  // The bits of the last word of a row that stand for columns.
+  static Row fullMask(int width)
+  {
+    int bits = width - (width - 1) / WORD_BITS * WORD_BITS;
+    return bits >= 64 ? Row(~Row(0)) : Row((uint64_t(1) << bits) - 1);
+  }
+  Row getLastFull() const
+  {
+    return W ? fullMask(W) : lastFull_;
+  }
+
+  // Move rows [from, to) down so that the first lands on row dst.
+  void moveRows(int from, int to, int dst);
+  void clearRow(int r);
+
+  void setHeight(int c, int height) const;
+  void recomputeHeights();
+
+  void settle() const
+  {
+    if(unsettled_) {
+      settleColumns();
+    }
+  }
+  void settleColumns() const;
+
+  int width_;
+  int rows_;
+  int words_;
+  Row lastFull_;
+
+  CellArray<Row, R * WORDS> bits_;
+  CellArray<signed char, W * R> colours_;
+
+  int filled_;
+
+  // Column heights and the sums built from them.  A column whose bit is
+  // set in stale_ may be lower than heights_ says, and unsettled_ is
+  // set while any is.
+  mutable CellArray<int, W> heights_;
+  mutable int aggregateHeight_;
+  mutable int bumpiness_;
+  mutable CellArray<Row, WORDS> stale_;
+  mutable bool unsettled_;
+};
+
+// A board whose size is given at run time.
+typedef BasicBoard<0, 0> Board;
+
+// One place the falling piece could come to rest, on a board of W
+// columns and R rows.
+template<int W, int R>
+struct BasicPlacement
+{
+  Piece piece;
+  // Position of the piece's 4x4 box, as for the falling piece.
+  int x;
+  int y;
+  int linesCleared;
+  // The well once the piece has locked and the full rows are gone.
+  BasicBoard<W, R> board;
+};
+
+typedef BasicPlacement<0, 0> Placement;
+
+// A board shared, copy on write, between a game, its copies and its
+// snapshots.  Copying one is a reference count; the board itself is
+// copied only when a holder is about to change a board that another
+// still holds, and the falling piece never touches the board before it
+// locks, so a search that snapshots every move copies the board at most
+// once per piece.  Boards live in blocks of a pool that every holder
+// shares: a block nobody holds goes on the pool's free list for the
+// next copy, and reuses the storage it has, so once the pool has as
+// many blocks as are ever held at once, nothing is allocated.  The
+// counts are not atomic; a game, its copies and its snapshots must stay
+// on one thread.
+template<typename B>
+class SharedBoard
+{
+public:
+  // Holds no board.
+  SharedBoard()
+    : block_(0)
+  {}
+  // A new pool, holding a copy of board.
+  explicit SharedBoard(const B& board);
 
-  Piece& operator =(const Piece& other);
+  SharedBoard(const SharedBoard& other)
+    : block_(other.block_)
+  {
+    if(block_) {
+      ++block_->refs;
+    }
+  }
+  SharedBoard& operator=(const SharedBoard& other)
+  {
+    if(other.block_) {
+      ++other.block_->refs;
+    }
+    release();
+    block_ = other.block_;
+    return *this;
+  }
+  ~SharedBoard()
+  {
+    release();
+  }
 
-  int getLeftMargin() const;
-  int getTopMargin() const;
-  int getRightMargin() const;
-  int getBottomMargin() const;
-  int getColourIndex() const;
+  const B& operator*() const
+  {
+    return block_->board;
+  }
+  const B* operator->() const
+  {
+    return &block_->board;
+  }
 
-  Piece rotateCW() const;
-  Piece rotateCCW() const;
+  // The board, to change.  If anything else holds it, it is copied into
+  // a block of the pool first.
+  B& write()
+  {
+    if(block_->refs > 1) {
+      unshare();
+    }
+    return block_->board;
+  }
 
-  bool isOn(int row, int col) const;
+  // Make sure the pool has count blocks free, each with storage for a
+  // board this size.
+  void reserve(int count);
 
 private:
-  void getColumn(int col, char *buf) const;
-  void getColumnRev(int col, char *buf) const;
+  struct Block;
+
+  struct Pool
+  {
+    // Blocks nobody holds.  Its capacity is kept at the number of
+    // blocks, so giving one back never allocates.
+    std::vector<Block*> free;
+    int blocks;
+    // Blocks somebody holds.  The pool goes when the last is let go.
+    int used;
+  };
+
+  struct Block
+  {
+    explicit Block(const B& b)
+      : board(b)
+    {}
+
+    B board;
+    int refs;
+    Pool* pool;
+  };
 
-  char desc_[16];
-  int cindex_;
-  int margins_[4];
+  static Block* newBlock(Pool* pool, const B& board);
+  static Block* take(Pool* pool, const B& board);
+  void unshare();
+  void release();
+
+  Block* block_;
+};
+
+// What has changed in a Game since its journal was last cleared, so a
+// renderer or spectator can do incremental work instead of rescanning
+// the whole well.
+struct ChangeSet
+{
+  struct Cell
+  {
+    short r;
+    short c;
+  };
+
+  ChangeSet();
+
+  void clear();
+  bool empty() const;
+
+  // Cells whose get() value or getLayer() may have changed.  A cell can
+  // be listed more than once.
+  std::vector<Cell> cells;
+  // Rows removed by line clears, as getClearedRows() reported them at
+  // the time.  Every row from the lowest of them up has moved.
+  std::vector<int> clearedRows;
+  // Number of new pieces that have entered the well.
+  int spawned;
+  bool gameOver;
+  // The whole well changed (a reset).
+  bool everything;
 };
 
-class Game
+// What games of every size have in common, so that Game::BAG7 and
+// StandardGame::BAG7 are the same value of the same type.
+struct GameTypes
+{
+  // How new pieces are chosen.  UNIFORM draws each piece independently;
+  // BAG7 deals all seven shapes in a random order, then reshuffles.
+  enum Randomiser {
+    UNIFORM,
+    BAG7
+  };
+
+  // Longest preview of upcoming pieces that can be asked for.
+  enum {
+    MAX_PREVIEW = 8
+  };
+
+  // What a cell of the well shows; see BasicGame::getLayer.
+  enum Layer {
+    LAYER_EMPTY,
+    LAYER_ACTIVE,
+    LAYER_LOCKED,
+    LAYER_GHOST
+  };
+};
+
+// A game in a well of W columns and H rows.  As with BasicBoard, both
+// may be 0 to give the size to the constructor instead; Game is that
+// kind, and StandardGame is the usual 10 by 20 well fixed at compile
+// time.  Both are instantiated in game.cpp.
+template<int W, int H>
+class BasicGame : public GameTypes
 {
 public:
+  // The size of the well when it is fixed at compile time, or 0.
+  enum {
+    WIDTH = W,
+    HEIGHT = H
+  };
+
+  // The board has four rows above the well.
+  typedef BasicBoard<W, (H ? H + 4 : 0)> BoardType;
+  typedef BasicPlacement<W, (H ? H + 4 : 0)> PlacementType;
+
   // Create a new game instance with a well of the given dimensions.
   // Note that internally, the board has four extra rows, to hold a 
-  // piece that has just begun to fall.
-  Game(int width, int height);
+  // piece that has just begun to fall.  The seed fixes the sequence of
+  // pieces, so two games built with the same arguments play out the
+  // same way given the same inputs.  A game of fixed size must be given
+  // its own dimensions.  A copy of a game shares its board until either
+  // of them changes it (see SharedBoard).
+  BasicGame(int width, int height, uint64_t seed = 0);
 
-  ~Game();
+  ~BasicGame();
 
   // Set the game to an initial state -- empty well, one piece waiting
-  // on top.
+  // on top.  The first form carries on with the current random stream;
+  // the second restarts it from the given seed.
   void reset();
+  void reset(uint64_t seed);
+
+  // Choose the randomiser, which applies to pieces drawn from now on,
+  // and the number of upcoming pieces (at most MAX_PREVIEW) that
+  // getPreview can show.
+  void setRandomiser(Randomiser randomiser);
+  void setPreviewLength(int length);
+
+  uint64_t getSeed() const
+  {
+    return seed_;
+  }
+
+  int getPreviewLength() const
+  {
+    return previewLength_;
+  }
+
+  // Shape of the i-th piece after the falling one, for i in
+  // [0, getPreviewLength()).
+  int getPreview(int i) const
+  {
+    return preview_[ (previewHead_ + i) % previewLength_ ];
+  }
 
   // Advance the game by one tick.  This usually just pushes the 
   // currently falling piece down by one row.  It can sometimes cause
@@ -83,15 +645,29 @@ public:
   bool rotateCW();
   bool rotateCCW();
 
-void dropShadowPiece();
+  // Work out again where the falling piece would land (its "ghost").
+  // Every move does this, so it only needs calling by hand if the
+  // ghost is wanted after something else has changed.
+  void dropShadowPiece();
+
+  // Fill out with every distinct final resting place of the falling
+  // piece: each orientation and column it fits in at its current
+  // height, dropped as far as it goes.  Orientations that only differ
+  // by a shift are listed once.  Passing the same vector back in reuses
+  // the boards it already holds.
+  void getPlacements(std::vector<PlacementType>& out) const;
+
+  // Lock the falling piece at a placement from getPlacements, as though
+  // it had been moved there and ticked.  Returns what tick() would.
+  int applyPlacement(const PlacementType& placement);
 
 	int getWidth() const
 	{ 
-		return board_width_;
+		return W ? W : board_width_;
 	}
 	int getHeight() const
 	{
-		return board_height_;
+		return H ? H : board_height_;
 	}
 
 	int getLinesCleared() const
@@ -103,6 +679,19 @@ void dropShadowPiece();
 	{
 		return score_;
 	}
+
+	// Number of pieces that have entered the well since the last reset.
+	int getPieceCount() const
+	{
+		return pieceCount_;
+	}
+
+	// Whether the game has ended.  Moves and ticks do nothing until the
+	// next reset.
+	bool isGameOver() const
+	{
+		return stopped_;
+	}
   // Get the contents of the cell at row r and column c.  Returns
   // the following values:
   // 				 -1: Cell is empty.
@@ -112,36 +701,189 @@ void dropShadowPiece();
   // for r in [0,board_height_+4), not [0,board_height_].  The top four
   // rows are added on to accommodate new pieces that are falling into
   // the well.
+  // The falling piece is not stored in the well; it is laid over the
+  // locked cells here.
   int get(int r, int c) const;
-  int& get(int r, int c);
+
+  // Which layer the cell at row r and column c shows, topmost first:
+  // the falling piece, then the locked well, then the ghost of the
+  // falling piece where it would land.
+  Layer getLayer(int r, int c) const;
+
+  // The falling piece, the position of its 4x4 box, and the row its box
+  // would drop to.
+  const Piece& getPiece() const
+  {
+    return piece_;
+  }
+  int getPieceX() const
+  {
+    return px_;
+  }
+  int getPieceY() const
+  {
+    return py_;
+  }
+  int getGhostY() const
+  {
+    return gy_;
+  }
+
+  // The locked cells of the well, with their surface metrics.  The
+  // falling piece is not part of it.
+  const BoardType& getBoard() const
+  {
+    return *board_;
+  }
+
+  // The rows removed when the most recent piece locked, bottom to top,
+  // numbered as they were before the rows above them moved down.
+  const std::vector<int>& getClearedRows() const
+  {
+    return clearedRows_;
+  }
+
+  // Append everything needed to carry on the game from this point to
+  // out, in a compact binary form, or carry on from such a point.  The
+  // well must be the size it was when the state was saved.  loadState
+  // moves p past what it read; if the data is bad it returns false and
+  // leaves the game as it was.  Neither touches the journal settings,
+  // but a load is journalled as a change to everything.
+  void saveState(std::vector<unsigned char>& out) const;
+  bool loadState(const unsigned char*& p, const unsigned char* end);
+
+  // A point in a game to go back to, for searches that try moves ahead
+  // and for undo (see undostack.hpp).  It holds everything but the
+  // journal.  The board is shared with the game (see SharedBoard), so
+  // taking or restoring a snapshot copies a few dozen words whatever
+  // the size of the well, and never allocates.  The game copies the
+  // board the next time it locks a piece; reserveBoards fills the pool
+  // ahead of time so that those copies do not allocate either.
+  class Snapshot
+  {
+  public:
+    // An empty snapshot, which cannot be restored.
+    Snapshot()
+      : board_width_(-1)
+      , board_height_(-1)
+    {
+      clearedRows_.reserve(4);
+    }
+
+    // Let go of the board, leaving the snapshot empty.
+    void clear()
+    {
+      board_ = SharedBoard<BoardType>();
+      board_width_ = -1;
+      board_height_ = -1;
+    }
+
+  private:
+    friend class BasicGame;
+
+    int board_width_;
+    int board_height_;
+    bool stopped_;
+    Piece piece_;
+    int px_;
+    int py_;
+    int gy_;
+    SharedBoard<BoardType> board_;
+    std::vector<int> clearedRows_;
+    Random rng_;
+    uint64_t seed_;
+    Randomiser randomiser_;
+    int bag_[Piece::NUM_SHAPES];
+    int bagLeft_;
+    int preview_[MAX_PREVIEW];
+    int previewHead_;
+    int previewLength_;
+    int score_;
+    int linesCleared_;
+    int pieceCount_;
+  };
+
+  // Save the game into out, or put it back as it was saved.  The well
+  // must be the size it was.  Like loadState, a restore leaves the
+  // journal settings alone and is journalled as a change to everything.
+  void takeSnapshot(Snapshot& out) const;
+  void restore(const Snapshot& snapshot);
+
+  // Make room for count more boards than the game now holds, for the
+  // copies it makes when it changes a board a snapshot or a copy of the
+  // game still holds.
+  void reserveBoards(int count)
+  {
+    board_.reserve(count);
+  }
+
+  // The change journal.  It is off by default, so that headless games
+  // pay nothing for it; once on, every change is added to it until the
+  // owner polls it and clears it.
+  void setJournalEnabled(bool enabled);
+  const ChangeSet& getChanges() const
+  {
+    return changes_;
+  }
+  void clearChanges()
+  {
+    changes_.clear();
+  }
 
 private:
   bool doesPieceFit(const Piece& p, int x, int y) const;
 
-  void removeRow(int y);
   int collapse();
+  int lockPiece();
 
-  void removePiece(const Piece& p, int x, int y);
-  void placePiece(const Piece& p, int x, int y);
+  bool tryMove(const Piece& p, int x, int y);
+  void journalPiece(const Piece& p, int x, int y);
+  void journalFallingPiece();
+  bool covers(const Piece& p, int x, int y, int r, int c) const;
 
+  int drawShape();
+  void fillPreview();
   void generateNewPiece();
 
+  // Copy the state a Snapshot holds from one game or snapshot to another.
+  template<typename To, typename From>
+  static void copyState(To& to, const From& from);
+
 private:
   int board_width_;
   int board_height_;
 
   bool stopped_;
 
+  // The falling piece is kept apart from the board and never written
+  // into it until it locks.  gy_ is the row it would drop to.
   Piece piece_;
-	Piece shadowPiece_;
-  int px_, sx_;
-  int py_, sy_;
+  int px_;
+  int py_;
+  int gy_;
 
-  int* board_;
+  SharedBoard<BoardType> board_;
+  std::vector<int> clearedRows_;
+
+  Random rng_;
+  uint64_t seed_;
+  Randomiser randomiser_;
+  int bag_[Piece::NUM_SHAPES];
+  int bagLeft_;
+  int preview_[MAX_PREVIEW];
+  int previewHead_;
+  int previewLength_;
+
+  bool journal_;
+  ChangeSet changes_;
 
 	// Extra stuff
 	int score_, linesCleared_;
+	int pieceCount_;
 	
 };
 
+typedef BasicGame<0, 0> Game;
+typedef BasicGame<10, 20> StandardGame;
+
 #endif // CS488_GAME_HPP
@@ -0,0 +1,189 @@
+//---------------------------------------------------------------------------
+//
+// gameenv.h/gameenv.cpp
+//
+//---------------------------------------------------------------------------
+
+#include <vector>
+
+#include "gameenv.h"
+#include "lockstep.hpp"
+
+static_assert(int(GAME_ENV_UNIFORM) == GameTypes::UNIFORM
+              && int(GAME_ENV_BAG7) == GameTypes::BAG7, "randomisers match");
+static_assert(int(GAME_ENV_NONE) == ACTION_NONE && int(GAME_ENV_LEFT) == ACTION_LEFT
+              && int(GAME_ENV_RIGHT) == ACTION_RIGHT
+              && int(GAME_ENV_ROTATE_CW) == ACTION_ROTATE_CW
+              && int(GAME_ENV_ROTATE_CCW) == ACTION_ROTATE_CCW
+              && int(GAME_ENV_DROP) == ACTION_DROP, "actions match");
+
+struct GameEnv
+{
+  explicit GameEnv(int games);
+
+  LockstepGames pack;
+  GameEnvLayout layout;
+  unsigned char* buffer;
+
+  std::vector<Action> actions;
+  std::vector<int> results;
+
+  // The piece count and whether the game was over when each board was
+  // last written.  A board only changes when a piece locks, and every
+  // lock brings on a new piece or ends the game.
+  std::vector<int> drawnPieces;
+  std::vector<char> drawnOver;
+};
+
+GameEnv::GameEnv(int games)
+  : pack(games)
+  , buffer(0)
+  , actions(games, ACTION_NONE)
+  , results(games, 0)
+  , drawnPieces(games, -1)
+  , drawnOver(games, 0)
+{}
+
+static uint64_t alignField(uint64_t offset)
+{
+  return (offset + 63) & ~uint64_t(63);
+}
+
+static void makeLayout(GameEnvLayout& layout, int games, int previewLength)
+{
+  const uint64_t n = games;
+  layout.games = games;
+  layout.rows = LockstepGames::ROWS;
+  layout.width = LockstepGames::WIDTH;
+  layout.preview_length = previewLength;
+
+  layout.board = 0;
+  layout.piece = alignField(layout.board + n * layout.rows * layout.width);
+  layout.preview = alignField(layout.piece + n * 4 * sizeof(int32_t));
+  layout.score = alignField(layout.preview + n * previewLength * sizeof(int32_t));
+  layout.lines = alignField(layout.score + n * sizeof(int32_t));
+  layout.done = alignField(layout.lines + n * sizeof(int32_t));
+  layout.size = alignField(layout.done + n);
+}
+
+template<typename T>
+static T* field(GameEnv* env, uint64_t offset)
+{
+  return (T*)(env->buffer + offset);
+}
+
+static void writeBoard(GameEnv* env, int i)
+{
+  const GameEnvLayout& l = env->layout;
+  env->pack.getOccupancy(i, field<uint8_t>(env, l.board) + i * l.rows * l.width);
+  env->drawnPieces[i] = env->pack.getPieceCount(i);
+  env->drawnOver[i] = env->pack.isGameOver(i);
+}
+
+static void writeGame(GameEnv* env, int i)
+{
+  const LockstepGames& pack = env->pack;
+  const GameEnvLayout& l = env->layout;
+
+  if(pack.getPieceCount(i) != env->drawnPieces[i] || pack.isGameOver(i) != env->drawnOver[i]) {
+    writeBoard(env, i);
+  }
+
+  int32_t* piece = field<int32_t>(env, l.piece) + i * 4;
+  piece[0] = pack.getPiece(i).getShape();
+  piece[1] = pack.getPiece(i).getOrientationIndex();
+  piece[2] = pack.getPieceX(i);
+  piece[3] = pack.getPieceY(i);
+
+  int32_t* preview = field<int32_t>(env, l.preview) + i * l.preview_length;
+  for(int k = 0; k < l.preview_length; ++k) {
+    preview[k] = pack.getPreview(i, k);
+  }
+
+  field<int32_t>(env, l.score)[i] = pack.getScore(i);
+  field<int32_t>(env, l.lines)[i] = pack.getLinesCleared(i);
+  field<uint8_t>(env, l.done)[i] = pack.isGameOver(i);
+}
+
+GameEnv* env_create(int32_t games, int32_t randomiser, int32_t preview_length,
+                    uint64_t seed)
+{
+  if(games <= 0 || (randomiser != GAME_ENV_UNIFORM && randomiser != GAME_ENV_BAG7)) {
+    return 0;
+  }
+
+  // No exception may cross into C.
+  GameEnv* env;
+  try {
+    env = new GameEnv(games);
+  } catch(...) {
+    return 0;
+  }
+
+  env->pack.setRandomiser(GameTypes::Randomiser(randomiser));
+  env->pack.setPreviewLength(preview_length);
+  for(int i = 0; i < games; ++i) {
+    env->pack.reset(i, streamSeed(seed, i));
+  }
+  makeLayout(env->layout, games, env->pack.getPreviewLength());
+  return env;
+}
+
+void env_destroy(GameEnv* env)
+{
+  delete env;
+}
+
+void env_layout(const GameEnv* env, GameEnvLayout* layout)
+{
+  *layout = env->layout;
+}
+
+int32_t env_attach(GameEnv* env, void* buffer, uint64_t size)
+{
+  if(buffer && (size < env->layout.size || (uintptr_t(buffer) & 3))) {
+    return -1;
+  }
+
+  env->buffer = (unsigned char*)buffer;
+  if(env->buffer) {
+    for(int i = 0; i < env->pack.size(); ++i) {
+      writeBoard(env, i);
+      writeGame(env, i);
+    }
+  }
+  return 0;
+}
+
+void env_reset(GameEnv* env, int32_t game, uint64_t seed)
+{
+  if(game < 0 || game >= env->pack.size()) {
+    return;
+  }
+
+  env->pack.reset(game, seed);
+  if(env->buffer) {
+    writeBoard(env, game);
+    writeGame(env, game);
+  }
+}
+
+int32_t env_step(GameEnv* env, const int32_t* actions, int32_t n)
+{
+  if(n != env->pack.size()) {
+    return -1;
+  }
+
+  for(int i = 0; i < n; ++i) {
+    env->actions[i] = (actions[i] >= 0 && actions[i] < NUM_ACTIONS)
+      ? Action(actions[i]) : ACTION_NONE;
+  }
+  env->pack.step(&env->actions[0], &env->results[0]);
+
+  if(env->buffer) {
+    for(int i = 0; i < n; ++i) {
+      writeGame(env, i);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+//---------------------------------------------------------------------------
+//
+// gameenv.h/gameenv.cpp
+//
+// A C interface to batches of standard 10 by 20 games, for driving the
+// engine from another language or process.  A batch is stepped as a
+// whole, on LockstepGames, and after every call its observations are
+// written straight into one buffer the caller owns: every field is an
+// array over the games at a fixed offset, so each can be used as a
+// tensor where it lies.  Nothing is allocated per game or per step.
+//
+// This header is plain C.  The engine is built into libgame488.so as
+// well as libgame488.a.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_GAMEENV_H
+#define CS488_GAMEENV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct GameEnv GameEnv;
+
+// Randomisers, as Game::Randomiser.
+enum {
+  GAME_ENV_UNIFORM = 0,
+  GAME_ENV_BAG7 = 1
+};
+
+// Actions, as Action in sim.hpp.  Anything else does nothing.
+enum {
+  GAME_ENV_NONE = 0,
+  GAME_ENV_LEFT = 1,
+  GAME_ENV_RIGHT = 2,
+  GAME_ENV_ROTATE_CW = 3,
+  GAME_ENV_ROTATE_CCW = 4,
+  GAME_ENV_DROP = 5
+};
+
+// Where the observations sit in the buffer.  The offsets are in bytes
+// from its start, and each is a multiple of 64.  Rows count up from the
+// bottom of the well and include the four above it.
+typedef struct GameEnvLayout
+{
+  int32_t games;
+  int32_t rows;
+  int32_t width;
+  int32_t preview_length;
+  // Bytes the buffer must hold.
+  uint64_t size;
+  // uint8_t[games][rows][width]: 1 where a locked cell fills the well.
+  // The falling piece is not drawn in.
+  uint64_t board;
+  // int32_t[games][4]: shape, orientation, and the column and row of
+  // the falling piece's 4x4 box, as Game::getPiece, getPieceX and
+  // getPieceY give them.
+  uint64_t piece;
+  // int32_t[games][preview_length]: the shapes to come, next first.
+  uint64_t preview;
+  // int32_t[games] each: the score and the rows cleared so far.
+  uint64_t score;
+  uint64_t lines;
+  // uint8_t[games]: 1 once the game is over.
+  uint64_t done;
+} GameEnvLayout;
+
+// Make a batch of games, each reset from streamSeed(seed, i).  Returns
+// NULL if games is not positive or randomiser is not known.  The
+// preview length is clamped to [1, 8].
+GameEnv* env_create(int32_t games, int32_t randomiser, int32_t preview_length,
+                    uint64_t seed);
+void env_destroy(GameEnv* env);
+
+void env_layout(const GameEnv* env, GameEnvLayout* layout);
+
+// Give the batch a buffer of size bytes, laid out as env_layout says,
+// and fill it in.  The buffer must stay valid until it is replaced or
+// the batch destroyed; NULL takes it away.  Returns 0, or -1 if the
+// buffer is too small or not 4-byte aligned.
+int32_t env_attach(GameEnv* env, void* buffer, uint64_t size);
+
+// Start one game again from seed.
+void env_reset(GameEnv* env, int32_t game, uint64_t seed);
+
+// Apply actions[i] to game i, then tick it, for all n games of the
+// batch at once, and write the new observations.  A game that is over
+// stays as it is until it is reset.  Returns 0, or -1 if n is not the
+// number of games.  The board of a game is only written when it
+// changes, so the caller must not write to the buffer.
+int32_t env_step(GameEnv* env, const int32_t* actions, int32_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CS488_GAMEENV_H
@@ -0,0 +1,747 @@
+//---------------------------------------------------------------------------
+//
+// lockstep.hpp/lockstep.cpp
+//
+//---------------------------------------------------------------------------
+
+#include <algorithm>
+#include <string.h>
+
+#include "lockstep.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Each well is STRIDE rows of 16 bits.  Column c of the well is bit
+// c + 3 of a row; the three bits either side are walls, always set.
+// Row r of the well is row r + FLOOR of the array, and the FLOOR rows
+// under it are all set, so a piece below the bottom or beside the well
+// collides just as a piece overlapping the stack does.  The rows above
+// the board are never looked at.
+enum {
+  STRIDE = 32,
+  FLOOR = 4,
+  WALL_BITS = 3,
+  // Games stepped together.  The widest kernel does all of them in one
+  // vector; the others take several goes.
+  BLOCK = 16,
+  // Bytes of column heights kept for each well.
+  HSTRIDE = 32
+};
+
+static const uint16_t EMPTY_ROW = 0xe007;
+static const uint16_t FULL_ROW = 0xffff;
+
+// The four rows of every orientation of every shape, moved to each
+// column it can be tried at, laid out as the four rows of the well
+// under it: piece row 3 in the low 16 bits, piece row 0 in the high.
+// A piece that would reach past the walls gets every bit set, so that
+// it never fits.  A piece only ever moves a column at a time from a
+// place it fits, so XSPAN columns from -XOFF on are enough.
+enum {
+  XOFF = 4,
+  XSPAN = LockstepGames::WIDTH + 5
+};
+
+// What a drop needs, for each orientation: byte c of lift is one more
+// than the lowest row of column c of the piece, and byte c of liftMask
+// is 0xff, or both are 0 if the column is empty.  See landingRow.
+struct StampTable
+{
+  uint64_t stamps[Piece::NUM_SHAPES * Piece::NUM_ORIENTATIONS * XSPAN];
+  uint32_t lift[Piece::NUM_SHAPES * Piece::NUM_ORIENTATIONS];
+  uint32_t liftMask[Piece::NUM_SHAPES * Piece::NUM_ORIENTATIONS];
+};
+
+static StampTable makeStampTable()
+{
+  StampTable t;
+  for(int s = 0; s < Piece::NUM_SHAPES; ++s) {
+    for(int o = 0; o < Piece::NUM_ORIENTATIONS; ++o) {
+      Piece p(s, o);
+      const int piece = s * Piece::NUM_ORIENTATIONS + o;
+      t.lift[piece] = 0;
+      t.liftMask[piece] = 0;
+      for(int c = 0; c < 4; ++c) {
+        const int bottom = p.getOrientation().bottom[c];
+        if(bottom >= 0) {
+          t.lift[piece] |= uint32_t(bottom + 1) << (c * 8);
+          t.liftMask[piece] |= uint32_t(0xff) << (c * 8);
+        }
+      }
+
+      for(int x = -XOFF; x < XSPAN - XOFF; ++x) {
+        uint64_t stamp = 0;
+        for(int r = 0; r < 4; ++r) {
+          for(int c = 0; c < 4; ++c) {
+            if(!p.isOn(r, c)) {
+              continue;
+            }
+            int bit = x + c + WALL_BITS;
+            if(bit < 0 || bit >= 16) {
+              stamp = ~uint64_t(0);
+            } else {
+              stamp |= uint64_t(1) << ((3 - r) * 16 + bit);
+            }
+          }
+        }
+        t.stamps[ piece * XSPAN + x + XOFF ] = stamp;
+      }
+    }
+  }
+  return t;
+}
+
+// PIECE_TABLE is a constant, so it is ready before this runs.
+static const StampTable STAMPS = makeStampTable();
+
+static inline int stampIndex(int shape, int orientation, int x)
+{
+  return (shape * Piece::NUM_ORIENTATIONS + orientation) * XSPAN + x + XOFF;
+}
+
+// The arrays of LockstepGames, as the kernels see them.
+struct LaneState
+{
+  int32_t* shape;
+  int32_t* orientation;
+  int32_t* x;
+  int32_t* y;
+  const int32_t* over;
+  const int32_t* level;
+  int32_t* score;
+  const int32_t* actions;
+  int32_t* results;
+  const uint16_t* bits;
+  const uint8_t* heights;
+};
+
+static inline bool fitsAt(const uint16_t* bits, int i, int shape, int orientation,
+                          int x, int y)
+{
+  uint64_t window;
+  memcpy(&window, bits + i * STRIDE + FLOOR + y - 3, sizeof(window));
+  return (window & STAMPS.stamps[ stampIndex(shape, orientation, x) ]) == 0;
+}
+
+// The row a piece with its box at column x lands on when it drops from
+// above the surface, as BasicBoard::dropRow works it out: every filled
+// column of the piece rests on top of the same column of the well, and
+// the highest of those wins.  The heights of the four columns under
+// the box are read as one word, and a byte of lift added to each; no
+// byte carries, as heights and lifts are small.
+static inline int landingRow(const uint8_t* heights, int i, int piece, int x)
+{
+  uint32_t h;
+  memcpy(&h, heights + i * HSTRIDE + x + XOFF, sizeof(h));
+  uint32_t v = (h & STAMPS.liftMask[piece]) + STAMPS.lift[piece];
+  int land = 0;
+  for(int c = 0; c < 4; ++c) {
+    land = std::max(land, int((v >> (c * 8)) & 0xff));
+  }
+  return land - 1;
+}
+
+// Each kernel steps the games of one block from first on, as
+// applyAction and Game::tick would, except that a piece that has
+// to lock is left where it is.  They return a mask of those games, bit
+// k standing for game first + k.
+
+static uint32_t stepScalar(const LaneState& s, int first)
+{
+  uint32_t locked = 0;
+  for(int k = 0; k < BLOCK; ++k) {
+    const int i = first + k;
+    if(s.over[i]) {
+      s.results[i] = -1;
+      continue;
+    }
+
+    const int shape = s.shape[i];
+    int o = s.orientation[i];
+    int x = s.x[i];
+    int y = s.y[i];
+
+    switch(s.actions[i]) {
+      case ACTION_LEFT:
+        if(fitsAt(s.bits, i, shape, o, x - 1, y)) {
+          --x;
+        }
+        break;
+      case ACTION_RIGHT:
+        if(fitsAt(s.bits, i, shape, o, x + 1, y)) {
+          ++x;
+        }
+        break;
+      case ACTION_ROTATE_CW:
+      case ACTION_ROTATE_CCW: {
+        int no = (o + (s.actions[i] == ACTION_ROTATE_CW ? 1 : 3)) & 3;
+        if(fitsAt(s.bits, i, shape, no, x, y)) {
+          o = no;
+        }
+        break;
+      }
+      case ACTION_DROP: {
+        // A piece slid in under an overhang falls a row at a time.
+        int ny = landingRow(s.heights, i, shape * Piece::NUM_ORIENTATIONS + o, x);
+        if(ny > y) {
+          ny = y;
+          while(fitsAt(s.bits, i, shape, o, x, ny - 1)) {
+            --ny;
+          }
+        }
+        s.score[i] += (y - ny + 1) * s.level[i];
+        y = ny;
+        break;
+      }
+      default:
+        break;
+    }
+
+    if(fitsAt(s.bits, i, shape, o, x, y - 1)) {
+      --y;
+    } else {
+      locked |= 1u << k;
+    }
+
+    s.orientation[i] = o;
+    s.x[i] = x;
+    s.y[i] = y;
+    s.results[i] = 0;
+  }
+  return locked;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Whether each game in m fits with its piece at (o, x, y).  base is the
+// index of row -3 of each game's well in the bit array, so the rows
+// under the piece are the two 32-bit halves from base + y on.  The
+// stamps are fetched as 32-bit halves too, from twice stampIndex on;
+// shapes holds twice stampIndex(shape, 0, 0).  Games outside m gather
+// nothing and come back false.
+__attribute__((target("avx512f")))
+static inline __mmask16 fitsAvx512(__mmask16 m, const uint16_t* bits, __m512i base,
+                                   __m512i shapes, __m512i o, __m512i x, __m512i y)
+{
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i two = _mm512_set1_epi32(2);
+  const int* stamps = (const int*)STAMPS.stamps;
+
+  __m512i st = _mm512_add_epi32(shapes, _mm512_mullo_epi32(o, _mm512_set1_epi32(2 * XSPAN)));
+  st = _mm512_add_epi32(st, _mm512_add_epi32(x, x));
+  __m512i w = _mm512_add_epi32(base, y);
+
+  __m512i slo = _mm512_mask_i32gather_epi32(zero, m, st, stamps, 4);
+  __m512i shi = _mm512_mask_i32gather_epi32(zero, m, _mm512_add_epi32(st, one), stamps, 4);
+  __m512i wlo = _mm512_mask_i32gather_epi32(zero, m, w, bits, 2);
+  __m512i whi = _mm512_mask_i32gather_epi32(zero, m, _mm512_add_epi32(w, two), bits, 2);
+
+  __m512i t = _mm512_or_si512(_mm512_and_si512(wlo, slo), _mm512_and_si512(whi, shi));
+  return _mm512_mask_testn_epi32_mask(m, t, t);
+}
+
+__attribute__((target("avx512f")))
+static uint32_t stepAvx512(const LaneState& s, int first)
+{
+  const __m512i zero = _mm512_setzero_si512();
+  const __m512i one = _mm512_set1_epi32(1);
+  const __m512i three = _mm512_set1_epi32(3);
+  const __m512i lane = _mm512_add_epi32(_mm512_set1_epi32(first),
+    _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+  const __m512i base = _mm512_add_epi32(_mm512_mullo_epi32(lane, _mm512_set1_epi32(STRIDE)),
+                                        _mm512_set1_epi32(FLOOR - 3));
+
+  const __m512i shape = _mm512_loadu_si512(s.shape + first);
+  const __m512i shapes = _mm512_add_epi32(
+    _mm512_mullo_epi32(shape, _mm512_set1_epi32(2 * Piece::NUM_ORIENTATIONS * XSPAN)),
+    _mm512_set1_epi32(2 * XOFF));
+  __m512i o = _mm512_loadu_si512(s.orientation + first);
+  __m512i x = _mm512_loadu_si512(s.x + first);
+  __m512i y = _mm512_loadu_si512(s.y + first);
+  const __m512i act = _mm512_loadu_si512(s.actions + first);
+
+  const __mmask16 alive = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(s.over + first), zero);
+  const __mmask16 left = _mm512_mask_cmpeq_epi32_mask(alive, act, _mm512_set1_epi32(ACTION_LEFT));
+  const __mmask16 right = _mm512_mask_cmpeq_epi32_mask(alive, act, _mm512_set1_epi32(ACTION_RIGHT));
+  const __mmask16 cw = _mm512_mask_cmpeq_epi32_mask(alive, act, _mm512_set1_epi32(ACTION_ROTATE_CW));
+  const __mmask16 ccw = _mm512_mask_cmpeq_epi32_mask(alive, act, _mm512_set1_epi32(ACTION_ROTATE_CCW));
+  const __mmask16 drop = _mm512_mask_cmpeq_epi32_mask(alive, act, _mm512_set1_epi32(ACTION_DROP));
+
+  // Moves and rotations: try the new place, keep it where it fits.
+  __m512i nx = _mm512_mask_sub_epi32(x, left, x, one);
+  nx = _mm512_mask_add_epi32(nx, right, x, one);
+  __m512i no = _mm512_mask_add_epi32(o, cw, o, one);
+  no = _mm512_and_si512(_mm512_mask_add_epi32(no, ccw, o, three), three);
+  const __mmask16 moved = fitsAvx512(left | right | cw | ccw, s.bits, base, shapes, no, nx, y);
+  x = _mm512_mask_mov_epi32(x, moved, nx);
+  o = _mm512_mask_mov_epi32(o, moved, no);
+
+  // Drops land on the column heights, as landingRow works out; pieces
+  // under an overhang fall a row at a time until none can.  The shifts
+  // and maxima are masked only because GCC 12 gives a false warning
+  // about the unmasked forms.
+  if(drop) {
+    const __mmask16 all = 0xffff;
+    const __m512i bytes = _mm512_set1_epi32(0xff);
+    const __m512i y0 = y;
+    const __m512i piece = _mm512_add_epi32(
+      _mm512_mullo_epi32(shape, _mm512_set1_epi32(Piece::NUM_ORIENTATIONS)), o);
+    const __m512i hbase = _mm512_add_epi32(_mm512_mullo_epi32(lane, _mm512_set1_epi32(HSTRIDE)),
+                                           _mm512_set1_epi32(XOFF));
+    __m512i h = _mm512_mask_i32gather_epi32(zero, drop, _mm512_add_epi32(hbase, x), s.heights, 1);
+    __m512i lift = _mm512_mask_i32gather_epi32(zero, drop, piece, STAMPS.lift, 4);
+    __m512i liftMask = _mm512_mask_i32gather_epi32(zero, drop, piece, STAMPS.liftMask, 4);
+    __m512i v = _mm512_add_epi32(_mm512_and_si512(h, liftMask), lift);
+    __m512i land = _mm512_maskz_max_epu32(all,
+      _mm512_maskz_max_epu32(all, _mm512_and_si512(v, bytes),
+                             _mm512_and_si512(_mm512_maskz_srli_epi32(all, v, 8), bytes)),
+      _mm512_maskz_max_epu32(all, _mm512_and_si512(_mm512_maskz_srli_epi32(all, v, 16), bytes),
+                             _mm512_maskz_srli_epi32(all, v, 24)));
+    land = _mm512_sub_epi32(land, one);
+    const __mmask16 under = _mm512_mask_cmpgt_epi32_mask(drop, land, y);
+    y = _mm512_mask_mov_epi32(y, drop & ~under, land);
+
+    for(__mmask16 m = under; m; ) {
+      __m512i below = _mm512_sub_epi32(y, one);
+      m = fitsAvx512(m, s.bits, base, shapes, o, x, below);
+      y = _mm512_mask_mov_epi32(y, m, below);
+    }
+    __m512i rows = _mm512_add_epi32(_mm512_sub_epi32(y0, y), one);
+    __m512i score = _mm512_loadu_si512(s.score + first);
+    score = _mm512_mask_add_epi32(score, drop,
+      score, _mm512_mullo_epi32(rows, _mm512_loadu_si512(s.level + first)));
+    _mm512_storeu_si512(s.score + first, score);
+  }
+
+  // The tick.
+  const __m512i below = _mm512_sub_epi32(y, one);
+  const __mmask16 falling = fitsAvx512(alive, s.bits, base, shapes, o, x, below);
+  y = _mm512_mask_mov_epi32(y, falling, below);
+
+  _mm512_storeu_si512(s.orientation + first, o);
+  _mm512_storeu_si512(s.x + first, x);
+  _mm512_storeu_si512(s.y + first, y);
+  _mm512_storeu_si512(s.results + first, _mm512_mask_mov_epi32(_mm512_set1_epi32(-1), alive, zero));
+  return alive & ~falling;
+}
+
+// As fitsAvx512, for 8 games, with masks as vectors.
+__attribute__((target("avx2")))
+static inline __m256i fitsAvx2(__m256i m, const uint16_t* bits, __m256i base,
+                               __m256i shapes, __m256i o, __m256i x, __m256i y)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i two = _mm256_set1_epi32(2);
+  const int* stamps = (const int*)STAMPS.stamps;
+  const int* rows = (const int*)bits;
+
+  __m256i st = _mm256_add_epi32(shapes, _mm256_mullo_epi32(o, _mm256_set1_epi32(2 * XSPAN)));
+  st = _mm256_add_epi32(st, _mm256_add_epi32(x, x));
+  __m256i w = _mm256_add_epi32(base, y);
+
+  __m256i slo = _mm256_mask_i32gather_epi32(zero, stamps, st, m, 4);
+  __m256i shi = _mm256_mask_i32gather_epi32(zero, stamps, _mm256_add_epi32(st, one), m, 4);
+  __m256i wlo = _mm256_mask_i32gather_epi32(zero, rows, w, m, 2);
+  __m256i whi = _mm256_mask_i32gather_epi32(zero, rows, _mm256_add_epi32(w, two), m, 2);
+
+  __m256i t = _mm256_or_si256(_mm256_and_si256(wlo, slo), _mm256_and_si256(whi, shi));
+  return _mm256_and_si256(m, _mm256_cmpeq_epi32(t, zero));
+}
+
+__attribute__((target("avx2")))
+static inline int maskBits(__m256i m)
+{
+  return _mm256_movemask_ps(_mm256_castsi256_ps(m));
+}
+
+__attribute__((target("avx2")))
+static uint32_t stepAvx2Half(const LaneState& s, int first)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i three = _mm256_set1_epi32(3);
+  const __m256i lane = _mm256_add_epi32(_mm256_set1_epi32(first),
+                                        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  const __m256i base = _mm256_add_epi32(_mm256_mullo_epi32(lane, _mm256_set1_epi32(STRIDE)),
+                                        _mm256_set1_epi32(FLOOR - 3));
+
+  const __m256i shape = _mm256_loadu_si256((const __m256i*)(s.shape + first));
+  const __m256i shapes = _mm256_add_epi32(
+    _mm256_mullo_epi32(shape, _mm256_set1_epi32(2 * Piece::NUM_ORIENTATIONS * XSPAN)),
+    _mm256_set1_epi32(2 * XOFF));
+  __m256i o = _mm256_loadu_si256((const __m256i*)(s.orientation + first));
+  __m256i x = _mm256_loadu_si256((const __m256i*)(s.x + first));
+  __m256i y = _mm256_loadu_si256((const __m256i*)(s.y + first));
+  const __m256i act = _mm256_loadu_si256((const __m256i*)(s.actions + first));
+
+  const __m256i alive = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(s.over + first)), zero);
+  const __m256i left = _mm256_and_si256(alive, _mm256_cmpeq_epi32(act, _mm256_set1_epi32(ACTION_LEFT)));
+  const __m256i right = _mm256_and_si256(alive, _mm256_cmpeq_epi32(act, _mm256_set1_epi32(ACTION_RIGHT)));
+  const __m256i cw = _mm256_and_si256(alive, _mm256_cmpeq_epi32(act, _mm256_set1_epi32(ACTION_ROTATE_CW)));
+  const __m256i ccw = _mm256_and_si256(alive, _mm256_cmpeq_epi32(act, _mm256_set1_epi32(ACTION_ROTATE_CCW)));
+  const __m256i drop = _mm256_and_si256(alive, _mm256_cmpeq_epi32(act, _mm256_set1_epi32(ACTION_DROP)));
+
+  // Moves and rotations: a lane mask is -1, so subtracting it adds one.
+  __m256i nx = _mm256_add_epi32(_mm256_sub_epi32(x, right), left);
+  __m256i no = _mm256_sub_epi32(o, cw);
+  no = _mm256_and_si256(_mm256_add_epi32(no, _mm256_and_si256(ccw, three)), three);
+  const __m256i moving = _mm256_or_si256(_mm256_or_si256(left, right), _mm256_or_si256(cw, ccw));
+  const __m256i moved = fitsAvx2(moving, s.bits, base, shapes, no, nx, y);
+  x = _mm256_blendv_epi8(x, nx, moved);
+  o = _mm256_blendv_epi8(o, no, moved);
+
+  if(maskBits(drop)) {
+    const __m256i bytes = _mm256_set1_epi32(0xff);
+    const __m256i y0 = y;
+    const __m256i piece = _mm256_add_epi32(
+      _mm256_mullo_epi32(shape, _mm256_set1_epi32(Piece::NUM_ORIENTATIONS)), o);
+    const __m256i hbase = _mm256_add_epi32(_mm256_mullo_epi32(lane, _mm256_set1_epi32(HSTRIDE)),
+                                           _mm256_set1_epi32(XOFF));
+    __m256i h = _mm256_mask_i32gather_epi32(zero, (const int*)s.heights,
+                                            _mm256_add_epi32(hbase, x), drop, 1);
+    __m256i lift = _mm256_mask_i32gather_epi32(zero, (const int*)STAMPS.lift, piece, drop, 4);
+    __m256i liftMask = _mm256_mask_i32gather_epi32(zero, (const int*)STAMPS.liftMask, piece, drop, 4);
+    __m256i v = _mm256_add_epi32(_mm256_and_si256(h, liftMask), lift);
+    __m256i land = _mm256_max_epu32(
+      _mm256_max_epu32(_mm256_and_si256(v, bytes), _mm256_and_si256(_mm256_srli_epi32(v, 8), bytes)),
+      _mm256_max_epu32(_mm256_and_si256(_mm256_srli_epi32(v, 16), bytes), _mm256_srli_epi32(v, 24)));
+    land = _mm256_sub_epi32(land, one);
+    const __m256i under = _mm256_and_si256(drop, _mm256_cmpgt_epi32(land, y));
+    y = _mm256_blendv_epi8(y, land, _mm256_andnot_si256(under, drop));
+
+    for(__m256i m = under; maskBits(m); ) {
+      __m256i below = _mm256_sub_epi32(y, one);
+      m = fitsAvx2(m, s.bits, base, shapes, o, x, below);
+      y = _mm256_blendv_epi8(y, below, m);
+    }
+    __m256i rows = _mm256_add_epi32(_mm256_sub_epi32(y0, y), one);
+    __m256i points = _mm256_mullo_epi32(rows, _mm256_loadu_si256((const __m256i*)(s.level + first)));
+    __m256i score = _mm256_loadu_si256((const __m256i*)(s.score + first));
+    score = _mm256_add_epi32(score, _mm256_and_si256(drop, points));
+    _mm256_storeu_si256((__m256i*)(s.score + first), score);
+  }
+
+  const __m256i below = _mm256_sub_epi32(y, one);
+  const __m256i falling = fitsAvx2(alive, s.bits, base, shapes, o, x, below);
+  y = _mm256_blendv_epi8(y, below, falling);
+
+  _mm256_storeu_si256((__m256i*)(s.orientation + first), o);
+  _mm256_storeu_si256((__m256i*)(s.x + first), x);
+  _mm256_storeu_si256((__m256i*)(s.y + first), y);
+  // Ended games get -1, which is what their all-clear mask is not.
+  _mm256_storeu_si256((__m256i*)(s.results + first), _mm256_xor_si256(alive, _mm256_set1_epi32(-1)));
+  return maskBits(_mm256_andnot_si256(falling, alive));
+}
+
+__attribute__((target("avx2")))
+static uint32_t stepAvx2(const LaneState& s, int first)
+{
+  return stepAvx2Half(s, first) | (stepAvx2Half(s, first + BLOCK / 2) << (BLOCK / 2));
+}
+
+// Worked out before main, as in bitrow.cpp.
+static bool hasAvx512()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx512f");
+}
+
+static bool hasAvx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+static const bool HAS_AVX512 = hasAvx512();
+static const bool HAS_AVX2 = hasAvx2();
+
+static uint32_t stepBlock(const LaneState& s, int first)
+{
+  if(HAS_AVX512) {
+    return stepAvx512(s, first);
+  }
+  return HAS_AVX2 ? stepAvx2(s, first) : stepScalar(s, first);
+}
+
+int LockstepGames::getVectorWidth()
+{
+  return HAS_AVX512 ? 16 : HAS_AVX2 ? 8 : 1;
+}
+
+#else
+
+static uint32_t stepBlock(const LaneState& s, int first)
+{
+  return stepScalar(s, first);
+}
+
+int LockstepGames::getVectorWidth()
+{
+  return 1;
+}
+
+#endif
+
+LockstepGames::LockstepGames(int count)
+  : count_(count)
+  , randomiser_(UNIFORM)
+  , previewLength_(1)
+{
+  const int padded = (count + BLOCK - 1) / BLOCK * BLOCK;
+  shape_.assign(padded, 0);
+  orientation_.assign(padded, 0);
+  x_.assign(padded, 0);
+  y_.assign(padded, 0);
+  over_.assign(padded, 1);
+  level_.assign(padded, 1);
+  score_.assign(padded, 0);
+  lines_.assign(padded, 0);
+  pieces_.assign(padded, 0);
+  previewHead_.assign(padded, 0);
+  preview_.assign(padded * MAX_PREVIEW, 0);
+  actions_.assign(padded, ACTION_NONE);
+  results_.assign(padded, -1);
+  bits_.assign(padded * STRIDE, EMPTY_ROW);
+  heights_.assign(padded * HSTRIDE, 0);
+  colours_.assign(padded * ROWS * WIDTH, -1);
+  rng_.resize(padded);
+  bag_.assign(padded * Piece::NUM_SHAPES, 0);
+  bagLeft_.assign(padded, 0);
+
+  for(int i = 0; i < padded; ++i) {
+    clearWell(i);
+  }
+  for(int i = 0; i < count; ++i) {
+    reset(i, 0);
+  }
+}
+
+void LockstepGames::setRandomiser(Randomiser randomiser)
+{
+  randomiser_ = randomiser;
+}
+
+void LockstepGames::setPreviewLength(int length)
+{
+  length = std::max(1, std::min(length, int(MAX_PREVIEW)));
+
+  // Each game keeps the pieces already promised and draws any new ones
+  // needed, in game order.
+  for(int i = 0; i < count_; ++i) {
+    int8_t upcoming[MAX_PREVIEW];
+    for(int k = 0; k < length; ++k) {
+      upcoming[k] = (k < previewLength_) ? getPreview(i, k) : drawShape(i);
+    }
+    std::copy(upcoming, upcoming + length, &preview_[ i * MAX_PREVIEW ]);
+    previewHead_[i] = 0;
+  }
+  previewLength_ = length;
+}
+
+void LockstepGames::clearWell(int i)
+{
+  uint16_t* rows = &bits_[ i * STRIDE ];
+  std::fill(rows, rows + FLOOR, FULL_ROW);
+  std::fill(rows + FLOOR, rows + STRIDE, EMPTY_ROW);
+  std::fill(&heights_[ i * HSTRIDE ], &heights_[ (i + 1) * HSTRIDE ], 0);
+  std::fill(&colours_[ i * ROWS * WIDTH ], &colours_[ (i + 1) * ROWS * WIDTH ], -1);
+}
+
+void LockstepGames::reset(int i, uint64_t seed)
+{
+  rng_[i].setSeed(seed);
+  clearWell(i);
+  over_[i] = 0;
+  level_[i] = 1;
+  score_[i] = 0;
+  lines_[i] = 0;
+  pieces_[i] = 0;
+  bagLeft_[i] = 0;
+  previewHead_[i] = 0;
+  for(int k = 0; k < previewLength_; ++k) {
+    preview_[ i * MAX_PREVIEW + k ] = drawShape(i);
+  }
+  generateNewPiece(i);
+}
+
+int LockstepGames::get(int i, int r, int c) const
+{
+  int pr = y_[i] - r;
+  int pc = c - x_[i];
+  if(!over_[i] && pr >= 0 && pr < 4 && pc >= 0 && pc < 4 && getPiece(i).isOn(pr, pc)) {
+    return shape_[i];
+  }
+  return colours_[ (i * ROWS + r) * WIDTH + c ];
+}
+
+// Eight columns at a time from a table: entry b is the eight cells
+// of the bits of b.
+struct CellTable
+{
+  uint8_t cells[256][8];
+};
+
+static CellTable makeCellTable()
+{
+  CellTable t;
+  for(int b = 0; b < 256; ++b) {
+    for(int k = 0; k < 8; ++k) {
+      t.cells[b][k] = (b >> k) & 1;
+    }
+  }
+  return t;
+}
+
+static const CellTable CELLS = makeCellTable();
+
+void LockstepGames::getOccupancy(int i, uint8_t* cells) const
+{
+  static_assert(WIDTH > 8 && WIDTH <= 16, "a row is one table entry and part of another");
+
+  const uint16_t* rows = &bits_[ i * STRIDE + FLOOR ];
+  for(int r = 0; r < ROWS; ++r, cells += WIDTH) {
+    const unsigned row = rows[r] >> WALL_BITS;
+    memcpy(cells, CELLS.cells[ row & 0xff ], 8);
+    memcpy(cells + 8, CELLS.cells[ (row >> 8) & 0xff ], WIDTH - 8);
+  }
+}
+
+int LockstepGames::drawShape(int i)
+{
+  if(randomiser_ == UNIFORM) {
+    return rng_[i].below(Piece::NUM_SHAPES);
+  }
+
+  int8_t* bag = &bag_[ i * Piece::NUM_SHAPES ];
+  if(bagLeft_[i] == 0) {
+    for(int k = 0; k < Piece::NUM_SHAPES; ++k) {
+      bag[k] = k;
+    }
+    for(int k = Piece::NUM_SHAPES - 1; k > 0; --k) {
+      std::swap(bag[k], bag[rng_[i].below(k + 1)]);
+    }
+    bagLeft_[i] = Piece::NUM_SHAPES;
+  }
+
+  return bag[ --bagLeft_[i] ];
+}
+
+void LockstepGames::generateNewPiece(int i)
+{
+  int8_t& next = preview_[ i * MAX_PREVIEW + previewHead_[i] ];
+  shape_[i] = next;
+  orientation_[i] = 0;
+  next = drawShape(i);
+  previewHead_[i] = (previewHead_[i] + 1) % previewLength_;
+  ++pieces_[i];
+
+  x_[i] = (WIDTH - 3) / 2;
+  y_[i] = HEIGHT + 3 - getPiece(i).getBottomMargin();
+}
+
+// Each column's height is the row above its highest filled cell.  The
+// well is scanned from the top down, and a column is done with as soon
+// as a cell of it turns up.
+void LockstepGames::recomputeHeights(int i)
+{
+  const uint16_t* rows = &bits_[ i * STRIDE + FLOOR ];
+  uint8_t* heights = &heights_[ i * HSTRIDE + XOFF ];
+  std::fill(heights, heights + WIDTH, 0);
+
+  uint16_t seen = EMPTY_ROW;
+  for(int r = ROWS - 1; r >= 0 && seen != FULL_ROW; --r) {
+    for(uint16_t fresh = rows[r] & ~seen; fresh; fresh &= fresh - 1) {
+      heights[ __builtin_ctz(fresh) - WALL_BITS ] = r + 1;
+    }
+    seen |= rows[r];
+  }
+}
+
+// The same as Game::lockPiece.  Only the four rows under the piece can
+// have filled up, since every full row was cleared when the last piece
+// locked.
+int LockstepGames::lockPiece(int i)
+{
+  const Piece p = getPiece(i);
+  const int x = x_[i];
+  const int y = y_[i];
+
+  uint16_t* rows = &bits_[ i * STRIDE + FLOOR ];
+  uint64_t window;
+  memcpy(&window, rows + y - 3, sizeof(window));
+  window |= STAMPS.stamps[ stampIndex(shape_[i], orientation_[i], x) ];
+  memcpy(rows + y - 3, &window, sizeof(window));
+
+  signed char* colours = &colours_[ i * ROWS * WIDTH ];
+  uint8_t* heights = &heights_[ i * HSTRIDE + XOFF ];
+  const PieceOrientation& o = p.getOrientation();
+  for(int k = 0; k < 4; ++k) {
+    const int r = y - o.cells[k][0];
+    const int c = x + o.cells[k][1];
+    colours[ r * WIDTH + c ] = p.getColourIndex();
+    heights[c] = std::max(int(heights[c]), r + 1);
+  }
+
+  if(y >= HEIGHT) {
+    over_[i] = 1;
+    return -1;
+  }
+
+  const int low = std::max(0, y - 3);
+  int rm = 0;
+  for(int r = low; r <= y; ++r) {
+    rm += (rows[r] == FULL_ROW);
+  }
+
+  if(rm) {
+    int dst = low;
+    for(int r = low; r < ROWS; ++r) {
+      if(rows[r] == FULL_ROW) {
+        continue;
+      }
+      if(dst != r) {
+        rows[dst] = rows[r];
+        memcpy(colours + dst * WIDTH, colours + r * WIDTH, WIDTH);
+      }
+      ++dst;
+    }
+    std::fill(rows + dst, rows + ROWS, EMPTY_ROW);
+    std::fill(colours + dst * WIDTH, colours + ROWS * WIDTH, -1);
+    recomputeHeights(i);
+  }
+
+  static const int POINTS[5] = { 10, 100, 600, 1500, 3200 };
+  score_[i] += POINTS[rm] * level_[i];
+  lines_[i] += rm;
+  level_[i] = 1 + lines_[i] / 10;
+  generateNewPiece(i);
+  return rm;
+}
+
+void LockstepGames::step(const Action* actions, int* results)
+{
+  std::copy(actions, actions + count_, actions_.begin());
+
+  LaneState s = {
+    &shape_[0], &orientation_[0], &x_[0], &y_[0], &over_[0], &level_[0],
+    &score_[0], &actions_[0], &results_[0], &bits_[0], &heights_[0]
+  };
+
+  // The pieces that have to lock are seen to straight after their
+  // block, while its wells are still in cache.
+  const int padded = int(shape_.size());
+  for(int first = 0; first < padded; first += BLOCK) {
+    uint32_t locked = stepBlock(s, first);
+    while(locked) {
+      int k = __builtin_ctz(locked);
+      locked &= locked - 1;
+      results_[ first + k ] = lockPiece(first + k);
+    }
+  }
+
+  std::copy(results_.begin(), results_.begin() + count_, results);
+}
@@ -0,0 +1,154 @@
+//---------------------------------------------------------------------------
+//
+// lockstep.hpp/lockstep.cpp
+//
+// Many independent games in standard 10 by 20 wells, stepped together.
+// Every game takes one action and one tick per step, and a game plays
+// out exactly as a StandardGame given the same seed and actions would:
+// the same pieces, moves, scores and cells.
+//
+// The state of the games is kept as structure of arrays, so that the
+// piece, position and score of a run of games load as one vector.  Each
+// well is a bitset of one cache line, with walls and a floor already
+// set around the cells, so that whether a piece fits is a single AND of
+// its four rows against the four rows of the well under it, and a drop
+// lands on column heights kept alongside.  Moves, drops and ticks then
+// run for 16 games per instruction with AVX-512 or 8 with AVX2,
+// fetching each game's rows with a gather; games that have ended are
+// masked off.  The rarer work of locking a piece, clearing rows and
+// drawing the next piece is done one game at a time.  Nothing here
+// depends on gtkmm or OpenGL.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_LOCKSTEP_HPP
+#define CS488_LOCKSTEP_HPP
+
+#include <vector>
+#include <stdint.h>
+
+#include "game.hpp"
+#include "random.hpp"
+#include "sim.hpp"
+
+class LockstepGames : public GameTypes
+{
+public:
+  enum {
+    WIDTH = StandardGame::WIDTH,
+    HEIGHT = StandardGame::HEIGHT,
+    // The board has four rows above the well, as in Game.
+    ROWS = HEIGHT + 4
+  };
+
+  // count games, each set up as a StandardGame built with a seed of 0
+  // would be.
+  explicit LockstepGames(int count);
+
+  int size() const
+  {
+    return count_;
+  }
+
+  // Choose the randomiser and the preview length of every game, as
+  // StandardGame::setRandomiser and setPreviewLength would.
+  void setRandomiser(Randomiser randomiser);
+  void setPreviewLength(int length);
+
+  // Start game i again from the given seed, as StandardGame::reset(seed)
+  // does.
+  void reset(int i, uint64_t seed);
+
+  // Apply actions[i] to game i, as applyAction would, then tick it, for
+  // every game at once.  results[i] gets what the tick returned; games
+  // that have ended get -1 and do not change.
+  void step(const Action* actions, int* results);
+
+  // The same as the accessors of StandardGame, for game i.
+  bool isGameOver(int i) const
+  {
+    return over_[i] != 0;
+  }
+  int getScore(int i) const
+  {
+    return score_[i];
+  }
+  int getLinesCleared(int i) const
+  {
+    return lines_[i];
+  }
+  int getPieceCount(int i) const
+  {
+    return pieces_[i];
+  }
+  int getPreviewLength() const
+  {
+    return previewLength_;
+  }
+  int getPreview(int i, int k) const
+  {
+    return preview_[ i * MAX_PREVIEW + (previewHead_[i] + k) % previewLength_ ];
+  }
+  Piece getPiece(int i) const
+  {
+    return Piece(shape_[i], orientation_[i]);
+  }
+  int getPieceX(int i) const
+  {
+    return x_[i];
+  }
+  int getPieceY(int i) const
+  {
+    return y_[i];
+  }
+  int get(int i, int r, int c) const;
+
+  // Write the locked cells of game i to cells, ROWS by WIDTH from the
+  // bottom row up: 1 where the well is filled, 0 where it is empty.  The
+  // falling piece is left out.
+  void getOccupancy(int i, uint8_t* cells) const;
+
+  // Games stepped per instruction on this machine: 16, 8, or 1 when
+  // the processor has neither AVX-512 nor AVX2.
+  static int getVectorWidth();
+
+private:
+  void clearWell(int i);
+  void recomputeHeights(int i);
+  int lockPiece(int i);
+  int drawShape(int i);
+  void generateNewPiece(int i);
+
+  int count_;
+  Randomiser randomiser_;
+  int previewLength_;
+
+  // One entry per game, padded to a whole number of vectors.  The
+  // padding games are over from the start.
+  std::vector<int32_t> shape_;
+  std::vector<int32_t> orientation_;
+  std::vector<int32_t> x_;
+  std::vector<int32_t> y_;
+  std::vector<int32_t> over_;
+  std::vector<int32_t> level_;
+  std::vector<int32_t> score_;
+  std::vector<int32_t> lines_;
+  std::vector<int32_t> pieces_;
+  std::vector<int32_t> previewHead_;
+  std::vector<int32_t> actions_;
+  std::vector<int32_t> results_;
+
+  // The occupancy of each well and the height of each of its columns
+  // (see lockstep.cpp), and the colour of each cell, ROWS by WIDTH.
+  std::vector<uint16_t> bits_;
+  std::vector<uint8_t> heights_;
+  std::vector<signed char> colours_;
+
+  std::vector<Random> rng_;
+  // MAX_PREVIEW upcoming shapes of each game, a ring from previewHead_.
+  std::vector<int8_t> preview_;
+  std::vector<int8_t> bag_;
+  std::vector<int8_t> bagLeft_;
+};
+
+#endif // CS488_LOCKSTEP_HPP
@@ -4,6 +4,12 @@
 
 int main(int argc, char** argv)
 {
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+  // The game runs on a thread of its own, and wakes the main loop
+  // through a Glib::Dispatcher
+  if(!Glib::thread_supported()) Glib::thread_init();
+#endif
+
   // Construct our main loop
   Gtk::Main kit(argc, argv);
 
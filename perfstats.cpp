@@ -0,0 +1,132 @@
+//---------------------------------------------------------------------------
+//
+// perfstats.hpp/perfstats.cpp
+//
+//---------------------------------------------------------------------------
+
+#include "perfstats.hpp"
+
+#include <algorithm>
+#include <stdlib.h>
+
+PerfStats::PerfStats()
+{
+  reset();
+}
+
+void PerfStats::reset()
+{
+  frameTimes_.clear();
+  frameEnds_.clear();
+  tickJitter_.clear();
+  inputLatency_.clear();
+  pendingInput_ = -1;
+}
+
+void PerfStats::frameDrawn(int64_t start, int64_t end)
+{
+  frameTimes_.add(end - start);
+  frameEnds_.add(end);
+
+  if(pendingInput_ >= 0) {
+    inputLatency_.add(end - pendingInput_);
+    pendingInput_ = -1;
+  }
+}
+
+void PerfStats::input(int64_t time)
+{
+  if(pendingInput_ < 0) {
+    pendingInput_ = time;
+  }
+}
+
+void PerfStats::tick(int64_t late)
+{
+  tickJitter_.add(late);
+}
+
+int64_t PerfStats::getFrameTime() const
+{
+  return frameTimes_.latest();
+}
+
+int PerfStats::getFramesPerSecond() const
+{
+  // Count back from the newest frame until one is a second older
+  int64_t newest = frameEnds_.latest();
+  int n = 0;
+  for(; n < frameEnds_.count; ++n) {
+    int64_t end = frameEnds_.values[(frameEnds_.next + HISTORY - 1 - n) % HISTORY];
+    if(newest - end >= 1000000) {
+      break;
+    }
+  }
+  return n;
+}
+
+int64_t PerfStats::getFramePercentile(double p) const
+{
+  if(frameTimes_.count == 0) {
+    return 0;
+  }
+
+  int64_t sorted[HISTORY];
+  std::copy(frameTimes_.values, frameTimes_.values + frameTimes_.count, sorted);
+  int k = std::min(frameTimes_.count - 1, int(p * frameTimes_.count));
+  std::nth_element(sorted, sorted + k, sorted + frameTimes_.count);
+  return sorted[k];
+}
+
+int PerfStats::getHistogramBin(int bin) const
+{
+  int n = 0;
+  for(int i = 0; i < frameTimes_.count; ++i) {
+    int b = std::min<int64_t>(frameTimes_.values[i] / 1000, BINS - 1);
+    if(b == bin) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+int64_t PerfStats::getTickJitter() const
+{
+  return tickJitter_.latest();
+}
+
+int64_t PerfStats::getMeanTickJitter() const
+{
+  if(tickJitter_.count == 0) {
+    return 0;
+  }
+
+  int64_t sum = 0;
+  for(int i = 0; i < tickJitter_.count; ++i) {
+    sum += llabs(tickJitter_.values[i]);
+  }
+  return sum / tickJitter_.count;
+}
+
+int64_t PerfStats::getMaxTickJitter() const
+{
+  int64_t worst = 0;
+  for(int i = 0; i < tickJitter_.count; ++i) {
+    worst = std::max<int64_t>(worst, llabs(tickJitter_.values[i]));
+  }
+  return worst;
+}
+
+int64_t PerfStats::getInputLatency() const
+{
+  return inputLatency_.latest();
+}
+
+int64_t PerfStats::getMaxInputLatency() const
+{
+  int64_t worst = 0;
+  for(int i = 0; i < inputLatency_.count; ++i) {
+    worst = std::max(worst, inputLatency_.values[i]);
+  }
+  return worst;
+}
@@ -0,0 +1,98 @@
+//---------------------------------------------------------------------------
+//
+// perfstats.hpp/perfstats.cpp
+//
+// Timing measurements for the viewer's performance overlay: how long
+// frames take to draw, how far game ticks stray from their schedule,
+// and how long an input takes to reach the screen.  Times are in
+// microseconds on a monotonic clock; the caller supplies them, so
+// nothing here depends on gtkmm.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_PERFSTATS_HPP
+#define CS488_PERFSTATS_HPP
+
+#include <stdint.h>
+
+class PerfStats
+{
+public:
+  // Samples kept of each kind, and the frame-time histogram: one bin
+  // per millisecond, the last bin holding everything slower.
+  enum { HISTORY = 256, BINS = 34 };
+
+  PerfStats();
+
+  void reset();
+
+  // A frame was drawn between start and end.
+  void frameDrawn(int64_t start, int64_t end);
+
+  // An input changed the game at this time.  The latency is measured
+  // up to the end of the next frame; later inputs before that frame
+  // count with the first.
+  void input(int64_t time);
+
+  // A game tick ran this long after its deadline.
+  void tick(int64_t late);
+
+  // Most recent frame's draw time, and frames drawn in the second
+  // before the most recent one.
+  int64_t getFrameTime() const;
+  int getFramesPerSecond() const;
+
+  // The draw time that fraction p of the remembered frames stay
+  // within, e.g. 0.99.
+  int64_t getFramePercentile(double p) const;
+
+  // Remembered frames with draw times in [bin, bin + 1) milliseconds.
+  int getHistogramBin(int bin) const;
+
+  // How late (or early, if negative) the most recent tick was, and the
+  // mean and the worst absolute difference over the remembered ticks.
+  int64_t getTickJitter() const;
+  int64_t getMeanTickJitter() const;
+  int64_t getMaxTickJitter() const;
+
+  // Input to the end of the frame that showed it: the latest, and the
+  // worst remembered.
+  int64_t getInputLatency() const;
+  int64_t getMaxInputLatency() const;
+
+private:
+  // A ring of the most recent samples of one kind.
+  struct History
+  {
+    int64_t values[HISTORY];
+    int count;
+    int next;
+
+    void clear()
+    {
+      count = 0;
+      next = 0;
+    }
+    void add(int64_t v)
+    {
+      values[next] = v;
+      next = (next + 1) % HISTORY;
+      if(count < HISTORY) {
+        ++count;
+      }
+    }
+    int64_t latest() const
+    {
+      return count ? values[(next + HISTORY - 1) % HISTORY] : 0;
+    }
+  };
+
+  History frameTimes_;
+  History frameEnds_;
+  History tickJitter_;
+  History inputLatency_;
+
+  int64_t pendingInput_;
+};
+
+#endif
@@ -0,0 +1,102 @@
+//---------------------------------------------------------------------------
+//
+// random.hpp
+//
+// A small, fast, seedable pseudo-random number generator
+// (xoshiro256**).  Every Game and every simulation worker owns one, so
+// nothing is shared between threads and a seed fully determines a run.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_RANDOM_HPP
+#define CS488_RANDOM_HPP
+
+#include <stdint.h>
+
+class Random
+{
+public:
+  explicit Random(uint64_t seed = 0)
+  {
+    setSeed(seed);
+  }
+
+  // Restart the stream.  The 256-bit state is filled from the seed with
+  // splitmix64, so nearby seeds still give unrelated streams.
+  void setSeed(uint64_t seed)
+  {
+    for(int i = 0; i < 4; ++i) {
+      seed += 0x9e3779b97f4a7c15ULL;
+      uint64_t z = seed;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      s_[i] = z ^ (z >> 31);
+    }
+  }
+
+  // The whole 256-bit state, for saving a stream part way through and
+  // carrying on from the same point later.
+  void getState(uint64_t state[4]) const
+  {
+    for(int i = 0; i < 4; ++i) {
+      state[i] = s_[i];
+    }
+  }
+  void setState(const uint64_t state[4])
+  {
+    for(int i = 0; i < 4; ++i) {
+      s_[i] = state[i];
+    }
+  }
+
+  uint64_t next()
+  {
+    const uint64_t result = rotl(s_[1] * 5, 7) * 9;
+    const uint64_t t = s_[1] << 17;
+
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+    s_[2] ^= t;
+    s_[3] = rotl(s_[3], 45);
+
+    return result;
+  }
+
+  // A uniformly distributed integer in [0, n), without the bias of
+  // next() % n.  Uses Lemire's multiply-and-reject method.
+  uint32_t below(uint32_t n)
+  {
+    uint64_t m = uint64_t(uint32_t(next() >> 32)) * n;
+    uint32_t low = uint32_t(m);
+    if(low < n) {
+      const uint32_t threshold = -n % n;
+      while(low < threshold) {
+        m = uint64_t(uint32_t(next() >> 32)) * n;
+        low = uint32_t(m);
+      }
+    }
+    return uint32_t(m >> 32);
+  }
+
+private:
+  static uint64_t rotl(uint64_t x, int k)
+  {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t s_[4];
+};
+
+// Derive the seed of the index-th independent stream from a base seed,
+// so that work can be split up any way without changing the results.
+inline uint64_t streamSeed(uint64_t seed, uint64_t index)
+{
+  uint64_t z = seed ^ (index * 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+#endif // CS488_RANDOM_HPP
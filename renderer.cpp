@@ -0,0 +1,718 @@
+//---------------------------------------------------------------------------
+//
+// renderer.hpp/renderer.cpp
+//
+// Draws the unit cubes that make up the well.  The viewer collects the
+// cubes of a frame into batches, and each batch goes to the GL in a
+// single instanced draw call: the unit cube lives in a static buffer,
+// only the position and colour of each cube are sent per frame, and a
+// GLSL program places, colours and lights every copy.  The locked stack
+// is kept as a mesh of its visible faces, which is rebuilt only when
+// the stack changes.
+// Nothing here depends on gtkmm; it only needs a current GL context.
+// That is the compatibility or 2.1 context gtkglext makes, so the
+// shaders are GLSL 1.20, but nothing uses fixed-function state,
+// GL_QUADS or client arrays.
+//
+//---------------------------------------------------------------------------
+
+#define GL_GLEXT_PROTOTYPES
+#include "renderer.hpp"
+#include <GL/glext.h>
+
+#include <algorithm>
+#include <stddef.h>
+#include <stdio.h>
+
+// The cube colours, by colour index.
+static const GLfloat CUBE_COLOURS[OUTLINE_COLOUR + 1][3] = {
+  { 0.514, 0.839, 0.965 }, // blue
+  { 0.553, 0.6,   0.796 }, // purple
+  { 0.988, 0.627, 0.373 }, // orange
+  { 0.69,  0.835, 0.529 }, // green
+  { 1.00,  0.453, 0.339 }, // red
+  { 0.949, 0.388, 0.639 }, // pink
+  { 1,     0.792, 0.204 }, // yellow
+  { 0,     0,     0     }  // black
+};
+
+// Face numbers, in the order of CUBE_FACES.
+enum {
+  FACE_FRONT,
+  FACE_TOP,
+  FACE_LEFT,
+  FACE_BOTTOM,
+  FACE_RIGHT,
+  FACE_BACK
+};
+
+// Vertex attribute indices, bound by name when the programs are
+// linked.  Each program uses only some of them.
+enum {
+  ATTRIB_POSITION,
+  ATTRIB_NORMAL,
+  ATTRIB_COLOUR,
+  ATTRIB_SHUFFLE,
+  ATTRIB_OFFSET,
+  ATTRIB_COLOUR_INDEX
+};
+
+static const char *const ATTRIB_NAMES[] = {
+  "position", "normal", "colour", "shuffle", "offset", "colourIndex", 0
+};
+
+// The lighting the fixed-function pipeline did for the viewer: one
+// positional light, colour material for ambient and diffuse, no
+// specular material.  The normal is not renormalised after the
+// modelview transform, just as it was not without GL_NORMALIZE.
+static const char VERTEX_SHADER[] =
+  "#version 120\n"
+  "uniform mat4 mvp;\n"
+  "uniform mat4 modelView;\n"
+  "uniform mat3 normalMatrix;\n"
+  "uniform vec3 lightPosition;\n"
+  "uniform vec3 lightAmbient;\n"
+  "uniform vec3 lightDiffuse;\n"
+  "attribute vec3 position;\n"
+  "attribute vec3 normal;\n"
+  "attribute vec4 colour;\n"
+  "varying vec4 shade;\n"
+  "void main()\n"
+  "{\n"
+  "  vec3 eye = (modelView * vec4(position, 1.0)).xyz;\n"
+  "  vec3 n = normalMatrix * normal;\n"
+  "  float d = max(dot(n, normalize(lightPosition - eye)), 0.0);\n"
+  "  vec3 lit = colour.rgb * (lightAmbient + d * lightDiffuse);\n"
+  "  shade = vec4(clamp(lit, 0.0, 1.0), colour.a);\n"
+  "  gl_Position = mvp * vec4(position, 1.0);\n"
+  "}\n";
+
+// The same lighting for copies of the unit cube.  offset and
+// colourIndex come once per cube; the cube's colour is looked up in
+// palette unless colourOverride gives one for the whole batch, and in
+// multicoloured mode each face takes the components of the colour in
+// the order given by shuffle.
+static const char INSTANCE_VERTEX_SHADER[] =
+  "#version 120\n"
+  "uniform mat4 mvp;\n"
+  "uniform mat4 modelView;\n"
+  "uniform mat3 normalMatrix;\n"
+  "uniform vec3 lightPosition;\n"
+  "uniform vec3 lightAmbient;\n"
+  "uniform vec3 lightDiffuse;\n"
+  "uniform vec3 palette[8];\n"
+  "uniform float colourOverride;\n"
+  "uniform bool multiColour;\n"
+  "attribute vec3 position;\n"
+  "attribute vec3 normal;\n"
+  "attribute vec3 shuffle;\n"
+  "attribute vec2 offset;\n"
+  "attribute float colourIndex;\n"
+  "varying vec4 shade;\n"
+  "float pick(vec3 c, float k)\n"
+  "{\n"
+  "  return k < 0.5 ? c.r : (k < 1.5 ? c.g : c.b);\n"
+  "}\n"
+  "void main()\n"
+  "{\n"
+  "  vec3 colour = palette[int(colourOverride >= 0.0 ? colourOverride : colourIndex)];\n"
+  "  if(multiColour) {\n"
+  "    colour = vec3(pick(colour, shuffle.x), pick(colour, shuffle.y),\n"
+  "                  pick(colour, shuffle.z));\n"
+  "  }\n"
+  "  vec4 p = vec4(position.xy + offset, position.z, 1.0);\n"
+  "  vec3 eye = (modelView * p).xyz;\n"
+  "  vec3 n = normalMatrix * normal;\n"
+  "  float d = max(dot(n, normalize(lightPosition - eye)), 0.0);\n"
+  "  vec3 lit = colour * (lightAmbient + d * lightDiffuse);\n"
+  "  shade = vec4(clamp(lit, 0.0, 1.0), 1.0);\n"
+  "  gl_Position = mvp * p;\n"
+  "}\n";
+
+static const char FRAGMENT_SHADER[] =
+  "#version 120\n"
+  "varying vec4 shade;\n"
+  "void main()\n"
+  "{\n"
+  "  gl_FragColor = shade;\n"
+  "}\n";
+
+// The unit cube, one face at a time: four corners, the normal, and
+// which of the cube's red, green and blue components each of the
+// face's red, green and blue take in multicoloured mode.
+struct CubeFace
+{
+  GLfloat corners[4][3];
+  GLfloat normal[3];
+  int shuffle[3];
+};
+
+static const CubeFace CUBE_FACES[6] = {
+  // Front face
+  { { {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} }, {1,0,0}, {0,1,2} },
+  // top face
+  { { {0,1,0}, {1,1,0}, {1,1,1}, {0,1,1} }, {0,1,0}, {1,0,2} },
+  // left face
+  { { {0,0,0}, {0,1,0}, {0,1,1}, {0,0,1} }, {0,0,1}, {2,1,0} },
+  // bottom face
+  { { {0,0,0}, {1,0,0}, {1,0,1}, {0,0,1} }, {0,1,0}, {0,2,1} },
+  // right face
+  { { {1,0,0}, {1,1,0}, {1,1,1}, {1,0,1} }, {0,0,1}, {2,0,1} },
+  // Back of front face
+  { { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0} }, {1,0,0}, {1,2,0} }
+};
+
+// Each face outline as four separate lines, so that every cube can go
+// in the same draw call.
+static const int EDGE_CORNERS[8] = { 0, 1, 1, 2, 2, 3, 3, 0 };
+
+// The unit cube as the instanced program takes it: every corner of
+// every face, then the corners of every face outline.
+struct CubeVertex
+{
+  GLfloat position[3];
+  GLfloat normal[3];
+  GLfloat shuffle[3];
+};
+
+enum {
+  CUBE_FACE_VERTICES = 6 * 4,
+  CUBE_FACE_INDICES = 6 * 6,
+  CUBE_EDGE_VERTICES = 6 * 8
+};
+
+static CubeVertex makeCubeVertex(const CubeFace& face, int corner)
+{
+  CubeVertex v;
+  for(int k = 0; k < 3; ++k) {
+    v.position[k] = face.corners[corner][k];
+    v.normal[k] = face.normal[k];
+    v.shuffle[k] = face.shuffle[k];
+  }
+  return v;
+}
+
+// Whether the GL is at least the given version.
+static bool hasVersion(int major, int minor)
+{
+  const char *version = (const char*)glGetString(GL_VERSION);
+  int ma = 0, mi = 0;
+  if(!version || sscanf(version, "%d.%d", &ma, &mi) != 2) {
+    return false;
+  }
+  return ma > major || (ma == major && mi >= minor);
+}
+
+CubeRenderer::CubeRenderer()
+  : instanced_(false)
+  , cubeBuffer_(0)
+  , cubeIndices_(0)
+  , instanceBuffer_(0)
+  , buffer_(0)
+  , quadIndices_(0)
+  , quadCapacity_(0)
+  , multiColourUniform_(-1)
+  , colourUniform_(-1)
+  , state_(0)
+{}
+
+CubeRenderer::~CubeRenderer()
+{
+  // The buffers go away with the GL context.
+}
+
+bool CubeRenderer::init(RenderState& state)
+{
+  state_ = &state;
+  if(!buffer_) {
+    glGenBuffers(1, &buffer_);
+    glGenBuffers(1, &quadIndices_);
+  }
+
+  if(!shader_.init(VERTEX_SHADER, FRAGMENT_SHADER, ATTRIB_NAMES)) {
+    return false;
+  }
+  state_->useProgram(shader_.getProgram());
+
+  // Instancing needs glVertexAttribDivisor, which is core from GL 3.3.
+  // Without it, or if its program will not build, the batches are
+  // drawn through vertices_ instead.
+  instanced_ = hasVersion(3, 3)
+    && instanceShader_.init(INSTANCE_VERTEX_SHADER, FRAGMENT_SHADER, ATTRIB_NAMES);
+  if(!instanced_ || cubeBuffer_) {
+    return true;
+  }
+
+  std::vector<CubeVertex> vertices;
+  std::vector<GLushort> indices;
+  for(int f = 0; f < 6; ++f) {
+    const GLushort v = vertices.size();
+    for(int corner = 0; corner < 4; ++corner) {
+      vertices.push_back(makeCubeVertex(CUBE_FACES[f], corner));
+    }
+    const GLushort quad[6] = { v, GLushort(v + 1), GLushort(v + 2),
+                               v, GLushort(v + 2), GLushort(v + 3) };
+    indices.insert(indices.end(), quad, quad + 6);
+  }
+  for(int f = 0; f < 6; ++f) {
+    for(int e = 0; e < 8; ++e) {
+      vertices.push_back(makeCubeVertex(CUBE_FACES[f], EDGE_CORNERS[e]));
+    }
+  }
+
+  glGenBuffers(1, &cubeBuffer_);
+  glGenBuffers(1, &cubeIndices_);
+  glGenBuffers(1, &instanceBuffer_);
+  state_->bindArrayBuffer(cubeBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(CubeVertex),
+               &vertices[0], GL_STATIC_DRAW);
+  state_->bindElementBuffer(cubeIndices_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort),
+               &indices[0], GL_STATIC_DRAW);
+
+  // The per-cube attributes move on once per instance, not per vertex.
+  glVertexAttribDivisor(ATTRIB_OFFSET, 1);
+  glVertexAttribDivisor(ATTRIB_COLOUR_INDEX, 1);
+
+  state_->useProgram(instanceShader_.getProgram());
+  glUniform3fv(instanceShader_.getUniform("palette"), OUTLINE_COLOUR + 1,
+               &CUBE_COLOURS[0][0]);
+  multiColourUniform_ = instanceShader_.getUniform("multiColour");
+  colourUniform_ = instanceShader_.getUniform("colourOverride");
+  return true;
+}
+
+// Matrix4x4 is row-major, GL wants column-major.
+static void toColumnMajor(const Matrix4x4& m, GLfloat *out)
+{
+  for(int c = 0; c < 4; ++c) {
+    for(int r = 0; r < 4; ++r) {
+      out[c*4 + r] = m[r][c];
+    }
+  }
+}
+
+void CubeRenderer::setLight(const Point3D& position, const Colour& ambient,
+                            const Colour& diffuse)
+{
+  const ShaderProgram *programs[2] = { &shader_, &instanceShader_ };
+  for(int p = 0; p < 2; ++p) {
+    if(!programs[p]->getProgram()) {
+      continue;
+    }
+    state_->useProgram(programs[p]->getProgram());
+    glUniform3f(programs[p]->getUniform("lightPosition"),
+                position[0], position[1], position[2]);
+    glUniform3f(programs[p]->getUniform("lightAmbient"),
+                ambient.R(), ambient.G(), ambient.B());
+    glUniform3f(programs[p]->getUniform("lightDiffuse"),
+                diffuse.R(), diffuse.G(), diffuse.B());
+  }
+}
+
+void CubeRenderer::setTransform(const Matrix4x4& modelView,
+                                const Matrix4x4& projection)
+{
+  GLfloat mvp[16], mv[16], normal[9];
+  toColumnMajor(projection * modelView, mvp);
+  toColumnMajor(modelView, mv);
+
+  // Normals go by the inverse transpose of the modelview
+  Matrix4x4 inverse = modelView.invert();
+  for(int c = 0; c < 3; ++c) {
+    for(int r = 0; r < 3; ++r) {
+      normal[c*3 + r] = inverse[c][r];
+    }
+  }
+
+  const ShaderProgram *programs[2] = { &shader_, &instanceShader_ };
+  for(int p = 0; p < 2; ++p) {
+    if(!programs[p]->getProgram()) {
+      continue;
+    }
+    state_->useProgram(programs[p]->getProgram());
+    glUniformMatrix4fv(programs[p]->getUniform("mvp"), 1, GL_FALSE, mvp);
+    glUniformMatrix4fv(programs[p]->getUniform("modelView"), 1, GL_FALSE, mv);
+    glUniformMatrix3fv(programs[p]->getUniform("normalMatrix"), 1, GL_FALSE, normal);
+  }
+}
+
+static void makeVertex(GLfloat *position, GLfloat *normal, GLubyte *colour,
+                       const CubeBatch::Instance& inst, const CubeFace& face,
+                       int corner, const GLfloat *rgb, bool multiColour)
+{
+  position[0] = face.corners[corner][0] + inst.x;
+  position[1] = face.corners[corner][1] + inst.y;
+  position[2] = face.corners[corner][2];
+  normal[0] = face.normal[0];
+  normal[1] = face.normal[1];
+  normal[2] = face.normal[2];
+  for(int k = 0; k < 3; ++k) {
+    GLfloat c = multiColour ? rgb[ face.shuffle[k] ] : rgb[k];
+    colour[k] = GLubyte(c * 255 + 0.5f);
+  }
+  colour[3] = 255;
+}
+
+void CubeRenderer::drawFaces(const CubeBatch& batch, bool multiColour)
+{
+  if(instanced_) {
+    state_->useProgram(instanceShader_.getProgram());
+    glUniform1i(multiColourUniform_, multiColour);
+    glUniform1f(colourUniform_, -1);
+    drawInstances(batch, true);
+    return;
+  }
+
+  const std::vector<CubeBatch::Instance>& insts = batch.getInstances();
+  vertices_.resize(insts.size() * 6 * 4);
+
+  Vertex *v = vertices_.empty() ? 0 : &vertices_[0];
+  for(size_t i = 0; i < insts.size(); ++i) {
+    const GLfloat *rgb = CUBE_COLOURS[ insts[i].colour ];
+    for(int f = 0; f < 6; ++f) {
+      for(int corner = 0; corner < 4; ++corner, ++v) {
+        makeVertex(v->position, v->normal, v->colour,
+                   insts[i], CUBE_FACES[f], corner, rgb, multiColour);
+      }
+    }
+  }
+
+  upload(QUADS);
+}
+
+void CubeRenderer::drawEdges(const CubeBatch& batch, int colour)
+{
+  if(instanced_) {
+    state_->useProgram(instanceShader_.getProgram());
+    glUniform1i(multiColourUniform_, false);
+    glUniform1f(colourUniform_, colour);
+    state_->lineWidth(2);
+    drawInstances(batch, false);
+    return;
+  }
+
+  const std::vector<CubeBatch::Instance>& insts = batch.getInstances();
+  vertices_.resize(insts.size() * 6 * 8);
+
+  Vertex *v = vertices_.empty() ? 0 : &vertices_[0];
+  for(size_t i = 0; i < insts.size(); ++i) {
+    const GLfloat *rgb = CUBE_COLOURS[ colour >= 0 ? colour : insts[i].colour ];
+    for(int f = 0; f < 6; ++f) {
+      for(int e = 0; e < 8; ++e, ++v) {
+        makeVertex(v->position, v->normal, v->colour,
+                   insts[i], CUBE_FACES[f], EDGE_CORNERS[e], rgb, false);
+      }
+    }
+  }
+
+  state_->lineWidth(2);
+  upload(LINES);
+}
+
+void CubeRenderer::drawInstances(const CubeBatch& batch, bool faces)
+{
+  const std::vector<CubeBatch::Instance>& insts = batch.getInstances();
+  if(insts.empty()) {
+    return;
+  }
+
+  // Only the cubes themselves go to the GL each frame.
+  state_->bindArrayBuffer(instanceBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, insts.size() * sizeof(CubeBatch::Instance),
+               &insts[0], GL_STREAM_DRAW);
+  state_->enableAttrib(ATTRIB_OFFSET);
+  state_->enableAttrib(ATTRIB_COLOUR_INDEX);
+  glVertexAttribPointer(ATTRIB_OFFSET, 2, GL_FLOAT, GL_FALSE,
+                        sizeof(CubeBatch::Instance),
+                        (GLvoid*)offsetof(CubeBatch::Instance, x));
+  glVertexAttribPointer(ATTRIB_COLOUR_INDEX, 1, GL_INT, GL_FALSE,
+                        sizeof(CubeBatch::Instance),
+                        (GLvoid*)offsetof(CubeBatch::Instance, colour));
+
+  state_->bindArrayBuffer(cubeBuffer_);
+  state_->enableAttrib(ATTRIB_POSITION);
+  state_->enableAttrib(ATTRIB_NORMAL);
+  state_->disableAttrib(ATTRIB_COLOUR);
+  state_->enableAttrib(ATTRIB_SHUFFLE);
+  glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(CubeVertex),
+                        (GLvoid*)offsetof(CubeVertex, position));
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(CubeVertex),
+                        (GLvoid*)offsetof(CubeVertex, normal));
+  glVertexAttribPointer(ATTRIB_SHUFFLE, 3, GL_FLOAT, GL_FALSE, sizeof(CubeVertex),
+                        (GLvoid*)offsetof(CubeVertex, shuffle));
+
+  if(faces) {
+    state_->bindElementBuffer(cubeIndices_);
+    glDrawElementsInstanced(GL_TRIANGLES, CUBE_FACE_INDICES, GL_UNSIGNED_SHORT,
+                            0, insts.size());
+  } else {
+    glDrawArraysInstanced(GL_LINES, CUBE_FACE_VERTICES, CUBE_EDGE_VERTICES,
+                          insts.size());
+  }
+
+  // Leave only the attributes every program shares enabled, so that
+  // a draw without instances never reads the per-cube arrays.
+  state_->disableAttrib(ATTRIB_SHUFFLE);
+  state_->disableAttrib(ATTRIB_OFFSET);
+  state_->disableAttrib(ATTRIB_COLOUR_INDEX);
+}
+
+// Send the vertices to the GL and draw them.
+void CubeRenderer::upload(Primitive primitive)
+{
+  if(vertices_.empty()) {
+    return;
+  }
+
+  state_->bindArrayBuffer(buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex),
+               &vertices_[0], GL_STREAM_DRAW);
+
+  drawVertices(buffer_, primitive, vertices_.size());
+}
+
+void CubeRenderer::reserveQuads(size_t count)
+{
+  if(count <= quadCapacity_) {
+    return;
+  }
+
+  // Grow by doubling, so that a growing stack does not refill it often
+  size_t capacity = std::max(count, quadCapacity_ * 2);
+  std::vector<GLuint> indices(capacity * 6);
+  for(size_t q = 0; q < capacity; ++q) {
+    GLuint v = q * 4;
+    GLuint *i = &indices[q * 6];
+    i[0] = v; i[1] = v + 1; i[2] = v + 2;
+    i[3] = v; i[4] = v + 2; i[5] = v + 3;
+  }
+
+  state_->bindElementBuffer(quadIndices_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+               &indices[0], GL_STATIC_DRAW);
+  quadCapacity_ = capacity;
+}
+
+void CubeRenderer::drawVertices(GLuint buffer, Primitive primitive, size_t count)
+{
+  if(count == 0 || !shader_.getProgram()) {
+    return;
+  }
+
+  // The arrays stay enabled between draws; only the pointers, which
+  // belong to the bound buffer, need setting each time.
+  state_->useProgram(shader_.getProgram());
+  state_->bindArrayBuffer(buffer);
+  state_->enableAttrib(ATTRIB_POSITION);
+  state_->enableAttrib(ATTRIB_NORMAL);
+  state_->enableAttrib(ATTRIB_COLOUR);
+  glVertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, position));
+  glVertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, normal));
+  glVertexAttribPointer(ATTRIB_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, colour));
+
+  if(primitive == QUADS) {
+    reserveQuads(count / 4);
+    state_->bindElementBuffer(quadIndices_);
+    glDrawElements(GL_TRIANGLES, count / 4 * 6, GL_UNSIGNED_INT, 0);
+  } else {
+    glDrawArrays(GL_LINES, 0, count);
+  }
+}
+
+StackMesh::StackMesh()
+  : faceBuffer_(0)
+  , edgeBuffer_(0)
+  , faceCount_(0)
+  , edgeCount_(0)
+  , state_(0)
+{}
+
+void StackMesh::init(RenderState& state)
+{
+  state_ = &state;
+  if(!faceBuffer_) {
+    glGenBuffers(1, &faceBuffer_);
+    glGenBuffers(1, &edgeBuffer_);
+  }
+}
+
+// Add one quad in the plane of the given cube face, covering the cells
+// from (x0, y0) to (x1, y1).  The corners of the unit face are
+// stretched to fit.
+void StackMesh::addFace(int face, float x0, float y0, float x1, float y1,
+                        int colour, bool multiColour)
+{
+  const CubeFace& f = CUBE_FACES[face];
+  const GLfloat *rgb = CUBE_COLOURS[colour];
+
+  for(int corner = 0; corner < 4; ++corner) {
+    CubeBatch::Instance origin = { 0, 0, colour };
+    CubeRenderer::Vertex v;
+    makeVertex(v.position, v.normal, v.colour, origin, f, corner, rgb, multiColour);
+    v.position[0] = v.position[0] ? x1 : x0;
+    v.position[1] = v.position[1] ? y1 : y0;
+    faces_.push_back(v);
+  }
+}
+
+// Add the four edges of one face of the cube at (row, col).
+void StackMesh::addEdges(int face, int row, int col)
+{
+  CubeBatch::Instance inst = { float(col), float(row), OUTLINE_COLOUR };
+  for(int e = 0; e < 8; ++e) {
+    CubeRenderer::Vertex v;
+    makeVertex(v.position, v.normal, v.colour, inst, CUBE_FACES[face],
+               EDGE_CORNERS[e], CUBE_COLOURS[OUTLINE_COLOUR], false);
+    edges_.push_back(v);
+  }
+}
+
+template<int W, int R>
+void StackMesh::build(const BasicBoard<W, R>& board, bool multiColour)
+{
+  // Nothing sits above the tallest column, and within a row the empty
+  // stretches are skipped a word at a time, so the cost follows the
+  // stack rather than the size of the well.
+  const int rows = board.getMaxHeight();
+  const int cols = board.getWidth();
+
+  faces_.clear();
+  edges_.clear();
+
+  // Front and back faces always show, since the well is one cube deep.
+  // Merge them greedily into rectangles of one colour: grow each run
+  // along its row as far as it goes, then grow the run upwards while
+  // the whole span above matches.
+  done_.assign(rows * cols, 0);
+  for(int r = 0; r < rows; ++r) {
+    for(int c = board.nextFilled(r, 0); c < cols; c = board.nextFilled(r, c + 1)) {
+      const int colour = board.get(r, c);
+      if(done_[r*cols + c]) {
+        continue;
+      }
+
+      int c1 = c + 1;
+      while(c1 < cols && board.get(r, c1) == colour && !done_[r*cols + c1]) {
+        ++c1;
+      }
+
+      int r1 = r + 1;
+      for(; r1 < rows; ++r1) {
+        bool match = true;
+        for(int k = c; k < c1 && match; ++k) {
+          match = board.get(r1, k) == colour && !done_[r1*cols + k];
+        }
+        if(!match) {
+          break;
+        }
+      }
+
+      for(int rr = r; rr < r1; ++rr) {
+        std::fill(done_.begin() + rr*cols + c, done_.begin() + rr*cols + c1, 1);
+      }
+
+      addFace(FACE_FRONT, c, r, c1, r1, colour, multiColour);
+      addFace(FACE_BACK, c, r, c1, r1, colour, multiColour);
+    }
+  }
+
+  // Top and bottom faces show where the cell above or below is empty;
+  // runs of them along a row are merged.
+  for(int r = 0; r < rows; ++r) {
+    for(int face = FACE_TOP; face <= FACE_BOTTOM; face += FACE_BOTTOM - FACE_TOP) {
+      const int nr = (face == FACE_TOP) ? r + 1 : r - 1;
+      const bool edge = (nr < 0 || nr >= rows);
+      int c = board.nextFilled(r, 0);
+      while(c < cols) {
+        const int colour = board.get(r, c);
+        if(!edge && board.get(nr, c) != -1) {
+          c = board.nextFilled(r, c + 1);
+          continue;
+        }
+
+        int c1 = c + 1;
+        while(c1 < cols && board.get(r, c1) == colour
+              && (edge || board.get(nr, c1) == -1)) {
+          ++c1;
+        }
+        addFace(face, c, r, c1, r + 1, colour, multiColour);
+        c = board.nextFilled(r, c1);
+      }
+    }
+  }
+
+  // Left and right faces show where the neighbouring cell is empty;
+  // runs of them up a column are merged.
+  for(int c = 0; c < cols; ++c) {
+    for(int face = FACE_LEFT; face <= FACE_RIGHT; face += FACE_RIGHT - FACE_LEFT) {
+      const int nc = (face == FACE_LEFT) ? c - 1 : c + 1;
+      const bool edge = (nc < 0 || nc >= cols);
+      const int height = board.getColumnHeight(c);
+      int r = 0;
+      while(r < height) {
+        const int colour = board.get(r, c);
+        if(colour == -1 || (!edge && board.get(r, nc) != -1)) {
+          ++r;
+          continue;
+        }
+
+        int r1 = r + 1;
+        while(r1 < height && board.get(r1, c) == colour
+              && (edge || board.get(r1, nc) == -1)) {
+          ++r1;
+        }
+        addFace(face, c, r, c + 1, r1, colour, multiColour);
+        r = r1;
+      }
+    }
+  }
+
+  // Outlines stay per cell, so the stack still reads as separate cubes,
+  // but faces that cannot be seen get none.
+  for(int r = 0; r < rows; ++r) {
+    for(int c = board.nextFilled(r, 0); c < cols; c = board.nextFilled(r, c + 1)) {
+      addEdges(FACE_FRONT, r, c);
+      addEdges(FACE_BACK, r, c);
+      if(r + 1 >= rows || board.get(r + 1, c) == -1) {
+        addEdges(FACE_TOP, r, c);
+      }
+      if(r == 0 || board.get(r - 1, c) == -1) {
+        addEdges(FACE_BOTTOM, r, c);
+      }
+      if(c == 0 || board.get(r, c - 1) == -1) {
+        addEdges(FACE_LEFT, r, c);
+      }
+      if(c + 1 >= cols || board.get(r, c + 1) == -1) {
+        addEdges(FACE_RIGHT, r, c);
+      }
+    }
+  }
+
+  faceCount_ = faces_.size();
+  edgeCount_ = edges_.size();
+
+  state_->bindArrayBuffer(faceBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, faceCount_ * sizeof(CubeRenderer::Vertex),
+               faceCount_ ? &faces_[0] : 0, GL_STATIC_DRAW);
+  state_->bindArrayBuffer(edgeBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, edgeCount_ * sizeof(CubeRenderer::Vertex),
+               edgeCount_ ? &edges_[0] : 0, GL_STATIC_DRAW);
+}
+
+void StackMesh::drawFaces(CubeRenderer& renderer) const
+{
+  renderer.drawVertices(faceBuffer_, CubeRenderer::QUADS, faceCount_);
+}
+
+void StackMesh::drawEdges(CubeRenderer& renderer) const
+{
+  state_->lineWidth(2);
+  renderer.drawVertices(edgeBuffer_, CubeRenderer::LINES, edgeCount_);
+}
+
+template void StackMesh::build(const BasicBoard<0, 0>&, bool);
+template void StackMesh::build(const BasicBoard<10, 24>&, bool);
@@ -0,0 +1,212 @@
+//---------------------------------------------------------------------------
+//
+// renderer.hpp/renderer.cpp
+//
+// Draws the unit cubes that make up the well.  The viewer collects the
+// cubes of a frame into batches, and each batch goes to the GL in a
+// single instanced draw call: the unit cube lives in a static buffer,
+// only the position and colour of each cube are sent per frame, and a
+// GLSL program places, colours and lights every copy.  The locked stack
+// is kept as a mesh of its visible faces, which is rebuilt only when
+// the stack changes.
+// Nothing here depends on gtkmm; it only needs a current GL context.
+// That is the compatibility or 2.1 context gtkglext makes, so the
+// shaders are GLSL 1.20, but nothing uses fixed-function state,
+// GL_QUADS or client arrays.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_RENDERER_HPP
+#define CS488_RENDERER_HPP
+
+#include <vector>
+#include <GL/gl.h>
+
+#include "algebra.hpp"
+#include "game.hpp"
+#include "renderstate.hpp"
+#include "shader.hpp"
+
+// Colour index used for the black cube outlines and the well border.
+#define OUTLINE_COLOUR 7
+
+// A list of cubes to be drawn together, one per occupied cell.
+class CubeBatch
+{
+public:
+  struct Instance
+  {
+    float x;
+    float y;
+    int colour;
+  };
+
+  void clear()
+  {
+    instances_.clear();
+  }
+
+  // Add the cube at the given row and column of the well.  Colours
+  // outside [0, OUTLINE_COLOUR] are empty cells and are ignored.
+  void add(int row, int col, int colour)
+  {
+    if(colour >= 0 && colour <= OUTLINE_COLOUR) {
+      Instance inst = { float(col), float(row), colour };
+      instances_.push_back(inst);
+    }
+  }
+
+  bool empty() const
+  {
+    return instances_.empty();
+  }
+  const std::vector<Instance>& getInstances() const
+  {
+    return instances_;
+  }
+
+private:
+  std::vector<Instance> instances_;
+};
+
+// Draws cubes through a GLSL program.  The model-view-projection
+// matrix is built on the CPU and set once per frame, and lighting is
+// done per vertex in the shader.  Batches are drawn instanced from one
+// unit cube; before GL 3.3 every cube is instead expanded into its own
+// vertices on the CPU and streamed to the GL.
+class CubeRenderer
+{
+public:
+  CubeRenderer();
+  ~CubeRenderer();
+
+  // Create the GL buffers and the shader program.  Call with the GL
+  // context current.  All GL state changes go through state.  Returns
+  // false if the program cannot be built; getLog() says why.
+  bool init(RenderState& state);
+  const std::string& getLog() const
+  {
+    return shader_.getLog();
+  }
+
+  // One point light, in eye coordinates.  ambient is added to every
+  // lit colour regardless of the normal.
+  void setLight(const Point3D& position, const Colour& ambient,
+                const Colour& diffuse);
+
+  // The transforms for everything drawn until the next call.
+  void setTransform(const Matrix4x4& modelView, const Matrix4x4& projection);
+
+  // Draw the faces of every cube in the batch, in one call.  With
+  // multiColour each face gets its own shuffle of the cube's colour.
+  void drawFaces(const CubeBatch& batch, bool multiColour);
+
+  // Draw the edges of every face of every cube in the batch, in one
+  // call.  If colour is given it overrides the colour of each cube.
+  void drawEdges(const CubeBatch& batch, int colour = -1);
+
+  struct Vertex
+  {
+    GLfloat position[3];
+    GLfloat normal[3];
+    GLubyte colour[4];
+  };
+
+  // What a run of Vertex structs makes: separate lines, or quads of
+  // four corners each, which are drawn as pairs of triangles.
+  enum Primitive {
+    LINES,
+    QUADS
+  };
+
+  // Draw count vertices from a buffer holding Vertex structs.
+  void drawVertices(GLuint buffer, Primitive primitive, size_t count);
+
+private:
+  // Draw one copy of the faces or the edges of the unit cube for each
+  // cube in the batch.
+  void drawInstances(const CubeBatch& batch, bool faces);
+
+  void upload(Primitive primitive);
+
+  // Make the quad index buffer big enough for count quads.
+  void reserveQuads(size_t count);
+
+  // Whether the GL can draw instanced; if not, batches take the path
+  // through vertices_.
+  bool instanced_;
+
+  // The unit cube's face vertices followed by its edge vertices, the
+  // triangles of its faces, and the cubes of the current batch.
+  GLuint cubeBuffer_;
+  GLuint cubeIndices_;
+  GLuint instanceBuffer_;
+
+  // Vertices of the current batch when not drawing instanced, kept
+  // between frames so that the storage is reused.
+  std::vector<Vertex> vertices_;
+  GLuint buffer_;
+
+  // Indices that split each quad 0123 into triangles 012 and 023
+  GLuint quadIndices_;
+  size_t quadCapacity_;
+
+  // The program for Vertex buffers, and the one for instances.
+  ShaderProgram shader_;
+  ShaderProgram instanceShader_;
+  GLint multiColourUniform_;
+  GLint colourUniform_;
+  RenderState *state_;
+};
+
+// The locked cells of a well as a single mesh.  Only faces that can be
+// seen are kept -- a side face shared by two filled cells is dropped --
+// and neighbouring faces in the same plane with the same colour are
+// merged into one larger quad.  The mesh lives in GL buffers and only
+// needs rebuilding when the board changes, that is when a piece locks
+// or rows are cleared.
+class StackMesh
+{
+public:
+  StackMesh();
+
+  // Create the GL buffers.  Call with the GL context current.
+  void init(RenderState& state);
+
+  // Rebuild from the locked cells of a board.  multiColour gives each
+  // face direction its own shuffle of the cell colour, as in
+  // CubeRenderer::drawFaces.  Built for run-time-sized boards and for
+  // the board of a StandardGame.
+  template<int W, int R>
+  void build(const BasicBoard<W, R>& board, bool multiColour);
+
+  // The merged faces, and the black outlines of each visible cell face.
+  void drawFaces(CubeRenderer& renderer) const;
+  void drawEdges(CubeRenderer& renderer) const;
+
+  size_t getFaceVertexCount() const
+  {
+    return faceCount_;
+  }
+  size_t getEdgeVertexCount() const
+  {
+    return edgeCount_;
+  }
+
+private:
+  void addFace(int face, float x0, float y0, float x1, float y1,
+               int colour, bool multiColour);
+  void addEdges(int face, int row, int col);
+
+  std::vector<CubeRenderer::Vertex> faces_;
+  std::vector<CubeRenderer::Vertex> edges_;
+  std::vector<char> done_;
+
+  GLuint faceBuffer_;
+  GLuint edgeBuffer_;
+  size_t faceCount_;
+  size_t edgeCount_;
+  RenderState *state_;
+};
+
+#endif // CS488_RENDERER_HPP
@@ -0,0 +1,171 @@
+//---------------------------------------------------------------------------
+//
+// renderstate.hpp/renderstate.cpp
+//
+//---------------------------------------------------------------------------
+
+#define GL_GLEXT_PROTOTYPES
+#include "renderstate.hpp"
+#include <GL/glext.h>
+
+RenderState::RenderState()
+{
+  forget();
+}
+
+void RenderState::forget()
+{
+  numCaps_ = 0;
+  lineWidthKnown_ = false;
+  drawBufferKnown_ = false;
+  arrayBufferKnown_ = false;
+  elementBufferKnown_ = false;
+  programKnown_ = false;
+  textureKnown_ = false;
+  attribsOn_ = 0;
+  attribsKnown_ = 0;
+  issued_ = 0;
+  filtered_ = 0;
+}
+
+// Count the call, and say whether it needs to go to the GL.
+bool RenderState::changed(bool same)
+{
+  if(same) {
+    ++filtered_;
+    return false;
+  }
+  ++issued_;
+  return true;
+}
+
+int RenderState::findCap(GLenum cap)
+{
+  for(int i = 0; i < numCaps_; ++i) {
+    if(caps_[i] == cap) {
+      return i;
+    }
+  }
+  if(numCaps_ == MAX_CAPS) {
+    return -1;
+  }
+  caps_[numCaps_] = cap;
+  capOn_[numCaps_] = -1;
+  return numCaps_++;
+}
+
+void RenderState::setCap(GLenum cap, bool on)
+{
+  // Capabilities past MAX_CAPS are not cached, and always go through
+  int i = findCap(cap);
+  if(!changed(i >= 0 && capOn_[i] == on)) {
+    return;
+  }
+  if(i >= 0) {
+    capOn_[i] = on;
+  }
+
+  switch(cap) {
+  case GL_VERTEX_ARRAY:
+  case GL_NORMAL_ARRAY:
+  case GL_COLOR_ARRAY:
+    if(on) {
+      glEnableClientState(cap);
+    } else {
+      glDisableClientState(cap);
+    }
+    break;
+  default:
+    if(on) {
+      glEnable(cap);
+    } else {
+      glDisable(cap);
+    }
+    break;
+  }
+}
+
+void RenderState::enable(GLenum cap)
+{
+  setCap(cap, true);
+}
+
+void RenderState::disable(GLenum cap)
+{
+  setCap(cap, false);
+}
+
+void RenderState::enableAttrib(GLuint index)
+{
+  unsigned bit = 1u << index;
+  if(changed((attribsKnown_ & attribsOn_ & bit) != 0)) {
+    glEnableVertexAttribArray(index);
+    attribsOn_ |= bit;
+    attribsKnown_ |= bit;
+  }
+}
+
+void RenderState::disableAttrib(GLuint index)
+{
+  unsigned bit = 1u << index;
+  if(changed((attribsKnown_ & ~attribsOn_ & bit) != 0)) {
+    glDisableVertexAttribArray(index);
+    attribsOn_ &= ~bit;
+    attribsKnown_ |= bit;
+  }
+}
+
+void RenderState::lineWidth(GLfloat width)
+{
+  if(changed(lineWidthKnown_ && lineWidth_ == width)) {
+    glLineWidth(width);
+    lineWidth_ = width;
+    lineWidthKnown_ = true;
+  }
+}
+
+void RenderState::drawBuffer(GLenum buffer)
+{
+  if(changed(drawBufferKnown_ && drawBuffer_ == buffer)) {
+    glDrawBuffer(buffer);
+    drawBuffer_ = buffer;
+    drawBufferKnown_ = true;
+  }
+}
+
+void RenderState::bindArrayBuffer(GLuint buffer)
+{
+  if(changed(arrayBufferKnown_ && arrayBuffer_ == buffer)) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    arrayBuffer_ = buffer;
+    arrayBufferKnown_ = true;
+  }
+}
+
+void RenderState::bindElementBuffer(GLuint buffer)
+{
+  if(changed(elementBufferKnown_ && elementBuffer_ == buffer)) {
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    elementBuffer_ = buffer;
+    elementBufferKnown_ = true;
+  }
+}
+
+void RenderState::useProgram(GLuint program)
+{
+  if(changed(programKnown_ && program_ == program)) {
+    glUseProgram(program);
+    program_ = program;
+    programKnown_ = true;
+  }
+}
+
+// Only texture unit 0 and GL_TEXTURE_2D are used.
+void RenderState::bindTexture(GLuint texture)
+{
+  if(changed(textureKnown_ && texture_ == texture)) {
+    glBindTexture(GL_TEXTURE_2D, texture);
+    texture_ = texture;
+    textureKnown_ = true;
+  }
+}
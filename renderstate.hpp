@@ -0,0 +1,88 @@
+//---------------------------------------------------------------------------
+//
+// renderstate.hpp/renderstate.cpp
+//
+// Remembers the GL state the viewer has set, so that a call which would
+// not change anything never reaches the driver.  All state changes made
+// through the renderer go through one RenderState; anything that
+// changes GL state behind its back must call forget() afterwards.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_RENDERSTATE_HPP
+#define CS488_RENDERSTATE_HPP
+
+#include <GL/gl.h>
+
+class RenderState
+{
+public:
+  RenderState();
+
+  // glEnable/glDisable, for capabilities and client arrays alike.
+  void enable(GLenum cap);
+  void disable(GLenum cap);
+
+  // glEnableVertexAttribArray/glDisableVertexAttribArray, for
+  // attribute indices below 32.
+  void enableAttrib(GLuint index);
+  void disableAttrib(GLuint index);
+
+  void lineWidth(GLfloat width);
+  void drawBuffer(GLenum buffer);
+  void bindArrayBuffer(GLuint buffer);
+  void bindElementBuffer(GLuint buffer);
+  void useProgram(GLuint program);
+  void bindTexture(GLuint texture);
+
+  // Treat every piece of state as unknown, so that the next call for
+  // each goes to the GL.  Use after a new context is made current.
+  void forget();
+
+  // Calls that reached the GL, and calls filtered out, since the last
+  // forget().
+  unsigned getIssued() const
+  {
+    return issued_;
+  }
+  unsigned getFiltered() const
+  {
+    return filtered_;
+  }
+
+private:
+  enum { MAX_CAPS = 16 };
+
+  // Index of cap in caps_, adding it if it is new.
+  int findCap(GLenum cap);
+  void setCap(GLenum cap, bool on);
+  bool changed(bool same);
+
+  // Capabilities seen so far and their state: 1 on, 0 off, -1 unknown.
+  GLenum caps_[MAX_CAPS];
+  signed char capOn_[MAX_CAPS];
+  int numCaps_;
+
+  GLfloat lineWidth_;
+  GLenum drawBuffer_;
+  GLuint arrayBuffer_;
+  GLuint elementBuffer_;
+  GLuint program_;
+  GLuint texture_;
+  bool lineWidthKnown_;
+  bool drawBufferKnown_;
+  bool arrayBufferKnown_;
+  bool elementBufferKnown_;
+  bool programKnown_;
+  bool textureKnown_;
+
+  // One bit per vertex attribute array: whether it is on, and whether
+  // that is known.
+  unsigned attribsOn_;
+  unsigned attribsKnown_;
+
+  unsigned issued_;
+  unsigned filtered_;
+};
+
+#endif
@@ -0,0 +1,451 @@
+//---------------------------------------------------------------------------
+//
+// replay.hpp/replay.cpp
+//
+//---------------------------------------------------------------------------
+
+#include "replay.hpp"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "varint.hpp"
+
+static const char FILE_MAGIC[8] = { 'G', '4', '8', '8', 'R', 'P', 'L', '1' };
+static const char INDEX_MAGIC[8] = { 'G', '4', '8', '8', 'I', 'D', 'X', '1' };
+
+// The code in the low bits of each record.  Ticks are 0 and actions
+// their Action value.
+enum {
+  RECORD_TICK = 0,
+  RECORD_KEYFRAME = 6,
+  RECORD_END = 7,
+  RECORD_BITS = 3
+};
+
+// Bytes held back before a write.
+enum { FLUSH_SIZE = 65536 };
+
+ReplayRecorder::ReplayRecorder(int keyframeInterval)
+  : keyframeInterval_(keyframeInterval > 0 ? keyframeInterval : 1)
+  , file_(0)
+  , failed_(false)
+  , written_(0)
+  , events_(0)
+  , time_(0)
+  , keyframePieces_(0)
+{}
+
+ReplayRecorder::~ReplayRecorder()
+{
+  close();
+}
+
+bool ReplayRecorder::open(const std::string& path, const Game& game, int64_t time)
+{
+  close();
+
+  file_ = fopen(path.c_str(), "wb");
+  if(!file_) {
+    return false;
+  }
+  failed_ = false;
+  buffer_.clear();
+  written_ = 0;
+  index_.clear();
+  events_ = 0;
+  time_ = time;
+
+  buffer_.insert(buffer_.end(), FILE_MAGIC, FILE_MAGIC + sizeof(FILE_MAGIC));
+  putVarint(buffer_, game.getWidth());
+  putVarint(buffer_, game.getHeight());
+  putVarint(buffer_, game.getSeed());
+  putVarint(buffer_, keyframeInterval_);
+
+  // Playback starts from a keyframe, so it never needs to know how the
+  // game was set up
+  keyframe(game);
+  return true;
+}
+
+void ReplayRecorder::tick(int64_t time, const Game& game)
+{
+  record(time, RECORD_TICK, game);
+}
+
+void ReplayRecorder::action(int64_t time, Action action, const Game& game)
+{
+  if(action > ACTION_NONE && action < NUM_ACTIONS) {
+    record(time, action, game);
+  }
+}
+
+void ReplayRecorder::record(int64_t time, int code, const Game& game)
+{
+  if(!file_) {
+    return;
+  }
+
+  // A clock that steps back is taken as no time passing
+  int64_t delta = time > time_ ? time - time_ : 0;
+  time_ += delta;
+  putVarint(buffer_, (uint64_t(delta) << RECORD_BITS) | code);
+  ++events_;
+
+  if(game.getPieceCount() >= keyframePieces_ + keyframeInterval_) {
+    keyframe(game);
+  }
+  if(buffer_.size() >= FLUSH_SIZE) {
+    flush();
+  }
+}
+
+void ReplayRecorder::keyframe(const Game& game)
+{
+  ReplayKeyframe k = { events_, time_, written_ + buffer_.size() };
+  index_.push_back(k);
+  keyframePieces_ = game.getPieceCount();
+
+  state_.clear();
+  game.saveState(state_);
+  putVarint(buffer_, RECORD_KEYFRAME);
+  putVarint(buffer_, state_.size());
+  buffer_.insert(buffer_.end(), state_.begin(), state_.end());
+}
+
+void ReplayRecorder::flush()
+{
+  if(!buffer_.empty() && fwrite(&buffer_[0], 1, buffer_.size(), file_) != buffer_.size()) {
+    failed_ = true;
+  }
+  written_ += buffer_.size();
+  buffer_.clear();
+}
+
+bool ReplayRecorder::close()
+{
+  if(!file_) {
+    return false;
+  }
+
+  putVarint(buffer_, RECORD_END);
+
+  uint64_t indexOffset = written_ + buffer_.size();
+  putVarint(buffer_, events_);
+  putVarint(buffer_, time_);
+  putVarint(buffer_, index_.size());
+  ReplayKeyframe last = { 0, 0, 0 };
+  for(size_t i = 0; i < index_.size(); ++i) {
+    putVarint(buffer_, index_[i].event - last.event);
+    putVarint(buffer_, index_[i].time - last.time);
+    putVarint(buffer_, index_[i].offset - last.offset);
+    last = index_[i];
+  }
+
+  for(int i = 0; i < 8; ++i) {
+    buffer_.push_back((unsigned char)(indexOffset >> (i * 8)));
+  }
+  buffer_.insert(buffer_.end(), INDEX_MAGIC, INDEX_MAGIC + sizeof(INDEX_MAGIC));
+  flush();
+
+  if(fclose(file_) != 0) {
+    failed_ = true;
+  }
+  file_ = 0;
+  return !failed_;
+}
+
+ReplayPlayer::ReplayPlayer()
+  : data_(0)
+  , size_(0)
+  , end_(0)
+  , width_(0)
+  , height_(0)
+  , seed_(0)
+  , keyframeInterval_(0)
+  , eventCount_(0)
+  , duration_(0)
+  , cursor_(0)
+  , position_(0)
+  , time_(0)
+{}
+
+ReplayPlayer::~ReplayPlayer()
+{
+  close();
+}
+
+void ReplayPlayer::close()
+{
+  if(data_) {
+    munmap((void*)data_, size_);
+  }
+  data_ = 0;
+  size_ = 0;
+  end_ = 0;
+  cursor_ = 0;
+  index_.clear();
+  game_.reset();
+}
+
+bool ReplayPlayer::open(const std::string& path)
+{
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if(fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < 32) {
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if(map == MAP_FAILED) {
+    return false;
+  }
+  data_ = (const unsigned char*)map;
+  size_ = st.st_size;
+
+  // Footer, then header, then index
+  const unsigned char* footer = data_ + size_ - 16;
+  uint64_t indexOffset = 0;
+  for(int i = 0; i < 8; ++i) {
+    indexOffset |= uint64_t(footer[i]) << (i * 8);
+  }
+  if(memcmp(footer + 8, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+     memcmp(data_, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+     indexOffset < sizeof(FILE_MAGIC) || indexOffset > size_ - 16) {
+    close();
+    return false;
+  }
+
+  const unsigned char* p = data_ + sizeof(FILE_MAGIC);
+  end_ = data_ + indexOffset;
+  uint64_t v[4];
+  for(int i = 0; i < 4; ++i) {
+    if(!getVarint(p, end_, v[i])) {
+      close();
+      return false;
+    }
+  }
+  width_ = int(v[0]);
+  height_ = int(v[1]);
+  seed_ = v[2];
+  keyframeInterval_ = int(v[3]);
+  if(width_ < 1 || height_ < 1) {
+    close();
+    return false;
+  }
+
+  const unsigned char* q = end_;
+  const unsigned char* footerEnd = footer;
+  uint64_t count, keyframes;
+  if(!getVarint(q, footerEnd, count) || !getVarint(q, footerEnd, v[0]) ||
+     !getVarint(q, footerEnd, keyframes) || keyframes == 0) {
+    close();
+    return false;
+  }
+  eventCount_ = long(count);
+  duration_ = int64_t(v[0]);
+  ReplayKeyframe k = { 0, 0, 0 };
+  for(uint64_t i = 0; i < keyframes; ++i) {
+    for(int j = 0; j < 3; ++j) {
+      if(!getVarint(q, footerEnd, v[j])) {
+        close();
+        return false;
+      }
+    }
+    k.event += long(v[0]);
+    k.time += int64_t(v[1]);
+    k.offset += v[2];
+    if(k.offset >= indexOffset) {
+      close();
+      return false;
+    }
+    index_.push_back(k);
+  }
+
+  game_.reset(new Game(width_, height_, seed_));
+  if(!restart(0)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool ReplayPlayer::restart(size_t i)
+{
+  const ReplayKeyframe& k = index_[i];
+  const unsigned char* p = data_ + k.offset;
+  uint64_t code, length;
+  if(!getVarint(p, end_, code) || code != RECORD_KEYFRAME ||
+     !getVarint(p, end_, length) || length > uint64_t(end_ - p)) {
+    return false;
+  }
+  const unsigned char* stateEnd = p + length;
+  if(!game_->loadState(p, stateEnd)) {
+    return false;
+  }
+
+  cursor_ = stateEnd;
+  position_ = k.event;
+  time_ = k.time;
+  return true;
+}
+
+bool ReplayPlayer::peek(int64_t& delta, int& code) const
+{
+  const unsigned char* p = cursor_;
+  uint64_t v;
+  if(!getVarint(p, end_, v)) {
+    return false;
+  }
+  delta = int64_t(v >> RECORD_BITS);
+  code = int(v & ((1 << RECORD_BITS) - 1));
+  return true;
+}
+
+bool ReplayPlayer::skipKeyframe()
+{
+  uint64_t length;
+  if(!getVarint(cursor_, end_, length) || length > uint64_t(end_ - cursor_)) {
+    return false;
+  }
+  cursor_ += length;
+  return true;
+}
+
+bool ReplayPlayer::step()
+{
+  if(!game_) {
+    return false;
+  }
+
+  for(;;) {
+    uint64_t v;
+    if(!getVarint(cursor_, end_, v)) {
+      return false;
+    }
+    int code = int(v & ((1 << RECORD_BITS) - 1));
+
+    if(code == RECORD_END) {
+      // Stay on the end marker, so that step() keeps saying so
+      --cursor_;
+      return false;
+    }
+    if(code == RECORD_KEYFRAME) {
+      // Playing on from the previous state gives the same game
+      if(!skipKeyframe()) {
+        return false;
+      }
+      continue;
+    }
+
+    time_ += int64_t(v >> RECORD_BITS);
+    ++position_;
+    if(code == RECORD_TICK) {
+      game_->tick();
+    } else {
+      applyAction(*game_, Action(code));
+    }
+    return true;
+  }
+}
+
+size_t ReplayPlayer::findKeyframe(long event) const
+{
+  size_t lo = 0, hi = index_.size();
+  while(hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if(index_[mid].event <= event) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+size_t ReplayPlayer::findKeyframeAt(int64_t time) const
+{
+  size_t lo = 0, hi = index_.size();
+  while(hi - lo > 1) {
+    size_t mid = (lo + hi) / 2;
+    if(index_[mid].time <= time) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+bool ReplayPlayer::seek(long event)
+{
+  if(!game_) {
+    return false;
+  }
+  if(event > eventCount_) {
+    event = eventCount_;
+  }
+
+  // Carry on from here if no keyframe is nearer
+  size_t k = findKeyframe(event);
+  if(event < position_ || index_[k].event > position_) {
+    if(!restart(k)) {
+      return false;
+    }
+  }
+  while(position_ < event) {
+    if(!step()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReplayPlayer::seekTime(int64_t time)
+{
+  if(!game_) {
+    return false;
+  }
+
+  size_t k = findKeyframeAt(time);
+  if(time < time_ || index_[k].time > time_) {
+    if(!restart(k)) {
+      return false;
+    }
+  }
+
+  // Play every event up to the time, but not the one after it
+  for(;;) {
+    int64_t delta;
+    int code;
+    if(!peek(delta, code)) {
+      return false;
+    }
+    if(code == RECORD_END) {
+      return true;
+    }
+    if(code == RECORD_KEYFRAME) {
+      uint64_t v;
+      getVarint(cursor_, end_, v);
+      if(!skipKeyframe()) {
+        return false;
+      }
+      continue;
+    }
+    if(time_ + delta > time) {
+      return true;
+    }
+    if(!step()) {
+      return false;
+    }
+  }
+}
@@ -0,0 +1,191 @@
+//---------------------------------------------------------------------------
+//
+// replay.hpp/replay.cpp
+//
+// Recording games to compact binary files, and playing them back with
+// fast seeking.  A replay is the inputs that drove the game -- ticks
+// and actions, each stamped with the time since the one before it --
+// with a keyframe of the whole game state every few pieces.  Playing
+// back runs the same Game operations on the same state, so the game
+// comes out exactly as it was.  Seeking starts from the last keyframe
+// before the target, so it costs at most one keyframe interval of
+// replaying wherever the target is.
+//
+// The file layout, with every integer a varint (see varint.hpp):
+//
+//   "G488RPL1", width, height, seed, keyframe interval
+//   records: (time delta << 3 | code), where code is 0 for a tick,
+//     an Action for an action, KEYFRAME followed by the length and
+//     bytes of Game::saveState, or END.  The first record is a
+//     keyframe, so the randomiser and the rest of the set-up come
+//     with it.
+//   index: event count, end time, keyframe count, then for each
+//     keyframe the deltas of its event number, time and file offset
+//   offset of the index as 8 little-endian bytes, "G488IDX1"
+//
+// Nothing here depends on gtkmm or OpenGL.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_REPLAY_HPP
+#define CS488_REPLAY_HPP
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "game.hpp"
+#include "sim.hpp"
+
+// Where a keyframe is, and how far into the game.
+struct ReplayKeyframe
+{
+  long event;
+  int64_t time;
+  uint64_t offset;
+};
+
+class ReplayRecorder
+{
+public:
+  // A keyframe is written every keyframeInterval pieces.
+  explicit ReplayRecorder(int keyframeInterval = 16);
+  ~ReplayRecorder();
+
+  // Start a file for game, as it is now, at the given time (in
+  // microseconds, on any clock).  Returns false if it cannot be
+  // written.
+  bool open(const std::string& path, const Game& game, int64_t time = 0);
+
+  // Record what was done to the game, once it has been done.  Actions
+  // must be recorded whether or not they moved anything, since a drop
+  // that goes nowhere still scores.
+  void tick(int64_t time, const Game& game);
+  void action(int64_t time, Action action, const Game& game);
+
+  // Finish off the file with its index.  Returns false if anything
+  // could not be written.
+  bool close();
+
+  bool isOpen() const
+  {
+    return file_ != 0;
+  }
+
+private:
+  void record(int64_t time, int code, const Game& game);
+  void keyframe(const Game& game);
+  void flush();
+
+  int keyframeInterval_;
+  FILE* file_;
+  bool failed_;
+
+  // Bytes waiting to be written, and the file offset they start at
+  std::vector<unsigned char> buffer_;
+  uint64_t written_;
+
+  std::vector<unsigned char> state_;
+  std::vector<ReplayKeyframe> index_;
+  long events_;
+  int64_t time_;
+  int keyframePieces_;
+};
+
+class ReplayPlayer
+{
+public:
+  ReplayPlayer();
+  ~ReplayPlayer();
+
+  // Map a replay file and set up its game at the start.  Returns false
+  // if the file cannot be read or is not a complete replay.
+  bool open(const std::string& path);
+  void close();
+
+  int getWidth() const
+  {
+    return width_;
+  }
+  int getHeight() const
+  {
+    return height_;
+  }
+  uint64_t getSeed() const
+  {
+    return seed_;
+  }
+  int getKeyframeInterval() const
+  {
+    return keyframeInterval_;
+  }
+  const std::vector<ReplayKeyframe>& getKeyframes() const
+  {
+    return index_;
+  }
+
+  // Number of ticks and actions recorded, and the time of the last.
+  long getEventCount() const
+  {
+    return eventCount_;
+  }
+  int64_t getDuration() const
+  {
+    return duration_;
+  }
+
+  // The game as of the current position: after getPosition() events,
+  // the last of them at getTime().
+  const Game& getGame() const
+  {
+    return *game_;
+  }
+  long getPosition() const
+  {
+    return position_;
+  }
+  int64_t getTime() const
+  {
+    return time_;
+  }
+
+  // Play the next event.  Returns false at the end.
+  bool step();
+
+  // Move to just after the given event, or to the last event at or
+  // before the given time.  Returns false if the file turns out to be
+  // damaged on the way.
+  bool seek(long event);
+  bool seekTime(int64_t time);
+
+private:
+  // Load the keyframe at index i of the index.
+  bool restart(size_t i);
+  // The index of the last keyframe at or before an event or a time.
+  size_t findKeyframe(long event) const;
+  size_t findKeyframeAt(int64_t time) const;
+  // Read the record header at cursor_ without moving past it.
+  bool peek(int64_t& delta, int& code) const;
+  // Move past the body of a keyframe whose header has been read.
+  bool skipKeyframe();
+
+  const unsigned char* data_;
+  size_t size_;
+  const unsigned char* end_;
+
+  int width_;
+  int height_;
+  uint64_t seed_;
+  int keyframeInterval_;
+  std::vector<ReplayKeyframe> index_;
+  long eventCount_;
+  int64_t duration_;
+
+  std::unique_ptr<Game> game_;
+  const unsigned char* cursor_;
+  long position_;
+  int64_t time_;
+};
+
+#endif // CS488_REPLAY_HPP
@@ -0,0 +1,84 @@
+//---------------------------------------------------------------------------
+//
+// shader.hpp/shader.cpp
+//
+//---------------------------------------------------------------------------
+
+#define GL_GLEXT_PROTOTYPES
+#include "shader.hpp"
+#include <GL/glext.h>
+
+#include <vector>
+
+ShaderProgram::ShaderProgram()
+  : program_(0)
+{}
+
+GLuint ShaderProgram::compile(GLenum type, const char *source)
+{
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &source, 0);
+  glCompileShader(shader);
+
+  GLint ok = GL_FALSE;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+  if(!ok) {
+    GLint length = 0;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> text(length + 1);
+    glGetShaderInfoLog(shader, length, 0, &text[0]);
+    log_ += &text[0];
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+bool ShaderProgram::init(const char *vertexSource, const char *fragmentSource,
+                         const char *const *attribs)
+{
+  if(program_) {
+    return true;
+  }
+  log_.clear();
+
+  GLuint vertex = compile(GL_VERTEX_SHADER, vertexSource);
+  GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentSource);
+  if(!vertex || !fragment) {
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    return false;
+  }
+
+  GLuint program = glCreateProgram();
+  glAttachShader(program, vertex);
+  glAttachShader(program, fragment);
+  for(GLuint i = 0; attribs[i]; ++i) {
+    glBindAttribLocation(program, i, attribs[i]);
+  }
+  glLinkProgram(program);
+
+  // The program keeps the shaders alive for as long as it needs them
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+
+  GLint ok = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &ok);
+  if(!ok) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::vector<char> text(length + 1);
+    glGetProgramInfoLog(program, length, 0, &text[0]);
+    log_ += &text[0];
+    glDeleteProgram(program);
+    return false;
+  }
+
+  program_ = program;
+  return true;
+}
+
+GLint ShaderProgram::getUniform(const char *name) const
+{
+  return glGetUniformLocation(program_, name);
+}
@@ -0,0 +1,44 @@
+//---------------------------------------------------------------------------
+//
+// shader.hpp/shader.cpp
+//
+// A GLSL program made from one vertex and one fragment shader.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_SHADER_HPP
+#define CS488_SHADER_HPP
+
+#include <string>
+#include <GL/gl.h>
+
+class ShaderProgram
+{
+public:
+  ShaderProgram();
+
+  // Compile and link the program.  Vertex attribute i is bound to
+  // attribs[i], up to the first null entry.  Returns false if either
+  // stage fails to compile or the program fails to link, in which case
+  // getLog() says why.  Call with the GL context current.
+  bool init(const char *vertexSource, const char *fragmentSource,
+            const char *const *attribs);
+
+  GLuint getProgram() const
+  {
+    return program_;
+  }
+  GLint getUniform(const char *name) const;
+  const std::string& getLog() const
+  {
+    return log_;
+  }
+
+private:
+  GLuint compile(GLenum type, const char *source);
+
+  GLuint program_;
+  std::string log_;
+};
+
+#endif
@@ -0,0 +1,184 @@
+//---------------------------------------------------------------------------
+//
+// sim.hpp/sim.cpp
+//
+// Headless driving of the game engine: simple move policies, a loop
+// that plays one game to the end with a policy, and the counters that
+// come out of it.  Nothing here depends on gtkmm or OpenGL.
+//
+//---------------------------------------------------------------------------
+
+#include "sim.hpp"
+#include "replay.hpp"
+
+Policy::~Policy()
+{}
+
+void Policy::reset(uint64_t)
+{}
+
+RandomPolicy::RandomPolicy(uint64_t seed)
+  : rng_(seed)
+{}
+
+void RandomPolicy::reset(uint64_t seed)
+{
+  rng_.setSeed(seed);
+}
+
+Action RandomPolicy::nextAction(const Game&)
+{
+  return Action(rng_.below(NUM_ACTIONS));
+}
+
+ScriptedPolicy::ScriptedPolicy(const std::string& script)
+  : script_(script)
+  , pos_(0)
+{}
+
+void ScriptedPolicy::reset(uint64_t)
+{
+  pos_ = 0;
+}
+
+Action ScriptedPolicy::nextAction(const Game&)
+{
+  if(script_.empty()) {
+    return ACTION_NONE;
+  }
+
+  char ch = script_[pos_];
+  pos_ = (pos_ + 1) % script_.size();
+
+  switch(ch) {
+    case 'l':
+      return ACTION_LEFT;
+    case 'r':
+      return ACTION_RIGHT;
+    case 'c':
+      return ACTION_ROTATE_CW;
+    case 'w':
+      return ACTION_ROTATE_CCW;
+    case 'd':
+      return ACTION_DROP;
+    default:
+      return ACTION_NONE;
+  }
+}
+
+template<int W, int H>
+BasicPlacementPolicy<W, H>::BasicPlacementPolicy()
+  : piece_(-1)
+  , orientation_(0)
+  , x_(0)
+{}
+
+template<int W, int H>
+void BasicPlacementPolicy<W, H>::reset()
+{
+  piece_ = -1;
+}
+
+template<int W, int H>
+void BasicPlacementPolicy<W, H>::choose(const BasicGame<W, H>& game)
+{
+  piece_ = game.getPieceCount();
+  orientation_ = game.getPiece().getOrientationIndex();
+  x_ = game.getPieceX();
+
+  game.getPlacements(placements_);
+  double best = 0;
+  for(size_t i = 0; i < placements_.size(); ++i) {
+    const typename BasicGame<W, H>::PlacementType& p = placements_[i];
+    double value = 0.76 * p.linesCleared - 0.51 * p.board.getAggregateHeight()
+      - 0.36 * p.board.getHoles() - 0.18 * p.board.getBumpiness();
+    if(i == 0 || value > best) {
+      best = value;
+      orientation_ = p.piece.getOrientationIndex();
+      x_ = p.x;
+    }
+  }
+}
+
+template<int W, int H>
+Action BasicPlacementPolicy<W, H>::nextAction(const BasicGame<W, H>& game)
+{
+  if(game.isGameOver()) {
+    return ACTION_NONE;
+  }
+  if(game.getPieceCount() != piece_) {
+    choose(game);
+  }
+
+  // A rotation or slide that is blocked is tried again on the next
+  // tick, a row lower; the piece lands wherever it has got to.
+  const int orientation = game.getPiece().getOrientationIndex();
+  if(orientation != orientation_) {
+    return (orientation + 1) % Piece::NUM_ORIENTATIONS == orientation_
+      || (orientation + 2) % Piece::NUM_ORIENTATIONS == orientation_
+      ? ACTION_ROTATE_CW : ACTION_ROTATE_CCW;
+  }
+  if(game.getPieceX() > x_) {
+    return ACTION_LEFT;
+  }
+  if(game.getPieceX() < x_) {
+    return ACTION_RIGHT;
+  }
+  return ACTION_DROP;
+}
+
+template class BasicPlacementPolicy<0, 0>;
+template class BasicPlacementPolicy<10, 20>;
+
+void PlacementPolicy::reset(uint64_t)
+{
+  policy_.reset();
+}
+
+Action PlacementPolicy::nextAction(const Game& game)
+{
+  return policy_.nextAction(game);
+}
+
+SimStats::SimStats()
+  : games(0)
+  , ticks(0)
+  , pieces(0)
+  , lines(0)
+  , score(0)
+{}
+
+void SimStats::merge(const SimStats& other)
+{
+  games += other.games;
+  ticks += other.ticks;
+  pieces += other.pieces;
+  lines += other.lines;
+  score += other.score;
+}
+
+void playGame(Game& game, Policy& policy, SimStats& stats, long maxTicks,
+              ReplayRecorder* recorder)
+{
+  for(long t = 0; maxTicks <= 0 || t < maxTicks; ++t) {
+    Action action = policy.nextAction(game);
+    applyAction(game, action);
+    if(recorder) {
+      recorder->action(t * PLAY_TICK_TIME, action, game);
+    }
+
+    ++stats.ticks;
+    int result = game.tick();
+    if(recorder) {
+      recorder->tick((t + 1) * PLAY_TICK_TIME, game);
+    }
+    if(result < 0) {
+      break;
+    }
+  }
+
+  ++stats.games;
+  stats.pieces += game.getPieceCount();
+  stats.lines += game.getLinesCleared();
+  stats.score += game.getScore();
+}
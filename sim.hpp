@@ -0,0 +1,154 @@
+//---------------------------------------------------------------------------
+//
+// sim.hpp/sim.cpp
+//
+// Headless driving of the game engine: simple move policies, a loop
+// that plays one game to the end with a policy, and the counters that
+// come out of it.  Nothing here depends on gtkmm or OpenGL.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_SIM_HPP
+#define CS488_SIM_HPP
+
+#include <string>
+#include <vector>
+#include "game.hpp"
+#include "random.hpp"
+
+class ReplayRecorder;
+
+// One input to the game.  A policy picks one of these before every tick.
+enum Action {
+  ACTION_NONE,
+  ACTION_LEFT,
+  ACTION_RIGHT,
+  ACTION_ROTATE_CW,
+  ACTION_ROTATE_CCW,
+  ACTION_DROP,
+  NUM_ACTIONS
+};
+
+// Apply an action to a game of any size.  Returns whether anything
+// moved.
+template<int W, int H>
+bool applyAction(BasicGame<W, H>& game, Action action)
+{
+  switch(action) {
+    case ACTION_LEFT:
+      return game.moveLeft();
+    case ACTION_RIGHT:
+      return game.moveRight();
+    case ACTION_ROTATE_CW:
+      return game.rotateCW();
+    case ACTION_ROTATE_CCW:
+      return game.rotateCCW();
+    case ACTION_DROP:
+      return game.drop();
+    default:
+      return false;
+  }
+}
+
+class Policy
+{
+public:
+  virtual ~Policy();
+
+  // Called before each game, so that a game's moves depend only on its
+  // own seed and not on what the policy played before.
+  virtual void reset(uint64_t seed);
+
+  // Called once before every tick.
+  virtual Action nextAction(const Game& game) = 0;
+};
+
+// Picks uniformly among all actions.
+class RandomPolicy : public Policy
+{
+public:
+  RandomPolicy(uint64_t seed);
+
+  virtual void reset(uint64_t seed);
+  virtual Action nextAction(const Game& game);
+
+private:
+  Random rng_;
+};
+
+// Cycles through a fixed script, one character per tick:
+//   l = left, r = right, c = rotate clockwise, w = rotate counter-clockwise,
+//   d = drop, anything else = do nothing.
+class ScriptedPolicy : public Policy
+{
+public:
+  ScriptedPolicy(const std::string& script);
+
+  virtual void reset(uint64_t seed);
+  virtual Action nextAction(const Game& game);
+
+private:
+  std::string script_;
+  size_t pos_;
+};
+
+// Chooses where each new piece should rest, from every placement
+// getPlacements offers, by how high, bumpy and holed it leaves the well
+// and how many rows it clears.  Then it steers the piece there, one
+// action a tick: rotating first, then sliding, then dropping.  It plays
+// well enough to clear rows steadily.  Instantiated in sim.cpp for Game
+// and StandardGame.
+template<int W, int H>
+class BasicPlacementPolicy
+{
+public:
+  BasicPlacementPolicy();
+
+  void reset();
+  Action nextAction(const BasicGame<W, H>& game);
+
+private:
+  void choose(const BasicGame<W, H>& game);
+
+  std::vector<typename BasicGame<W, H>::PlacementType> placements_;
+  // The piece the target was chosen for, by getPieceCount, or -1.
+  int piece_;
+  int orientation_;
+  int x_;
+};
+
+class PlacementPolicy : public Policy
+{
+public:
+  virtual void reset(uint64_t seed);
+  virtual Action nextAction(const Game& game);
+
+private:
+  BasicPlacementPolicy<0, 0> policy_;
+};
+
+struct SimStats
+{
+  SimStats();
+
+  void merge(const SimStats& other);
+
+  long games;
+  long ticks;
+  long pieces;
+  long lines;
+  long long score;
+};
+
+// Play the game from its current state until it is over, or until
+// maxTicks ticks have passed if maxTicks > 0.  Adds what happened to
+// stats.  If a recorder is given, every action and tick goes to it,
+// stamped as though each tick took PLAY_TICK_TIME microseconds.
+void playGame(Game& game, Policy& policy, SimStats& stats, long maxTicks = 0,
+              ReplayRecorder* recorder = 0);
+
+// The time a tick stands for in recorded headless games: the default
+// game speed of the viewer.
+const int64_t PLAY_TICK_TIME = 500000;
+
+#endif // CS488_SIM_HPP
@@ -0,0 +1,462 @@
+//---------------------------------------------------------------------------
+//
+// game488-sim
+//
+// Plays a batch of games with no display attached and reports how fast
+// the engine ran.  -j sets the number of worker threads (0, the default,
+// uses every hardware thread).
+//
+// -R plays only the first game of the batch and records it to a replay
+// file.  -P plays a replay file back instead, seeking to event -k (the
+// end by default), and reports the game there.
+//
+// -L plays the batch on one thread twice with the random policy, once a
+// StandardGame at a time and once with the given number of games in
+// lockstep, and compares the speed and the totals.  Then it plays the
+// batch again with the placement policy, which clears rows, each
+// lockstep game beside a StandardGame, and compares every game cell by
+// cell.  It needs the standard well.
+//
+//   game488-sim [-n games] [-p random|script|place] [-s script] [-S seed]
+//               [-r uniform|bag] [-t max-ticks] [-w width] [-h height]
+//               [-j threads] [-R replay-file] [-L lanes]
+//   game488-sim -P replay-file [-k event]
+//
+//---------------------------------------------------------------------------
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.hpp"
+#include "lockstep.hpp"
+#include "replay.hpp"
+
+static void usage(const char *prog)
+{
+  std::cerr << "usage: " << prog
+            << " [-n games] [-p random|script|place] [-s script] [-S seed]"
+            << " [-r uniform|bag] [-t max-ticks] [-w width] [-h height]"
+            << " [-j threads] [-R replay-file] [-L lanes]" << std::endl
+            << "       " << prog << " -P replay-file [-k event]" << std::endl;
+  exit(1);
+}
+
+// Play the first game of the batch, as BatchRunner would, recording it.
+static int recordGame(const BatchConfig& config, Policy* p, const std::string& path)
+{
+  std::unique_ptr<Policy> policy(p);
+  Game game(config.width, config.height);
+  game.setRandomiser(config.randomiser);
+  uint64_t seed = streamSeed(config.seed, 0);
+  game.reset(seed);
+  policy->reset(~seed);
+
+  ReplayRecorder recorder;
+  if(!recorder.open(path, game)) {
+    std::cerr << "cannot write " << path << std::endl;
+    return 1;
+  }
+  SimStats stats;
+  playGame(game, *policy, stats, config.maxTicks, &recorder);
+  if(!recorder.close()) {
+    std::cerr << "error writing " << path << std::endl;
+    return 1;
+  }
+
+  std::cout << "ticks:      " << stats.ticks << std::endl
+            << "pieces:     " << stats.pieces << std::endl
+            << "lines:      " << stats.lines << std::endl
+            << "score:      " << stats.score << std::endl;
+  return 0;
+}
+
+static int playReplay(const std::string& path, long event)
+{
+  ReplayPlayer player;
+  if(!player.open(path)) {
+    std::cerr << "cannot read replay " << path << std::endl;
+    return 1;
+  }
+  if(event < 0) {
+    event = player.getEventCount();
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool ok = player.seek(event);
+  double secs = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  if(!ok) {
+    std::cerr << "replay " << path << " is damaged" << std::endl;
+    return 1;
+  }
+
+  const Game& game = player.getGame();
+  std::cout << "well:       " << player.getWidth() << "x" << player.getHeight() << std::endl
+            << "seed:       " << player.getSeed() << std::endl
+            << "events:     " << player.getEventCount() << std::endl
+            << "keyframes:  " << player.getKeyframes().size() << std::endl
+            << "duration:   " << player.getDuration() / 1e6 << " s" << std::endl
+            << "position:   " << player.getPosition() << std::endl
+            << "time:       " << player.getTime() / 1e6 << " s" << std::endl
+            << "pieces:     " << game.getPieceCount() << std::endl
+            << "lines:      " << game.getLinesCleared() << std::endl
+            << "score:      " << game.getScore() << std::endl
+            << "seek:       " << secs * 1e6 << " us" << std::endl;
+  return 0;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+  double secs = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  return secs > 0 ? secs : 1e-9;
+}
+
+// Both runs take their actions as RandomPolicy would, from a generator
+// seeded with the complement of the game's seed.
+static void playStandard(const BatchConfig& config, SimStats& stats)
+{
+  StandardGame game(10, 20);
+  game.setRandomiser(config.randomiser);
+  Random rng;
+
+  for(long g = 0; g < config.games; ++g) {
+    uint64_t seed = streamSeed(config.seed, g);
+    game.reset(seed);
+    rng.setSeed(~seed);
+
+    for(long t = 0; config.maxTicks <= 0 || t < config.maxTicks; ++t) {
+      applyAction(game, Action(rng.below(NUM_ACTIONS)));
+      ++stats.ticks;
+      if(game.tick() < 0) {
+        break;
+      }
+    }
+
+    ++stats.games;
+    stats.pieces += game.getPieceCount();
+    stats.lines += game.getLinesCleared();
+    stats.score += game.getScore();
+  }
+}
+
+// Each lane plays games one after another until the batch runs out.
+// A lane with nothing left to play sits at the end of its last game.
+static void playLockstep(const BatchConfig& config, int lanes, SimStats& stats)
+{
+  LockstepGames pack(lanes);
+  pack.setRandomiser(config.randomiser);
+  std::vector<Random> rng(lanes);
+  std::vector<long> ticks(lanes, 0);
+  std::vector<char> playing(lanes, 0);
+  std::vector<Action> actions(lanes, ACTION_NONE);
+  std::vector<int> results(lanes);
+  long next = 0;
+  int running = 0;
+
+  auto start = [&](int i) {
+    uint64_t seed = streamSeed(config.seed, next++);
+    pack.reset(i, seed);
+    rng[i].setSeed(~seed);
+    ticks[i] = 0;
+    playing[i] = 1;
+    ++running;
+  };
+
+  for(int i = 0; i < lanes && next < config.games; ++i) {
+    start(i);
+  }
+
+  while(running > 0) {
+    for(int i = 0; i < lanes; ++i) {
+      actions[i] = playing[i] ? Action(rng[i].below(NUM_ACTIONS)) : ACTION_NONE;
+    }
+    pack.step(&actions[0], &results[0]);
+
+    for(int i = 0; i < lanes; ++i) {
+      if(!playing[i]) {
+        continue;
+      }
+      ++stats.ticks;
+      if(results[i] >= 0 && (config.maxTicks <= 0 || ++ticks[i] < config.maxTicks)) {
+        continue;
+      }
+
+      ++stats.games;
+      stats.pieces += pack.getPieceCount(i);
+      stats.lines += pack.getLinesCleared(i);
+      stats.score += pack.getScore(i);
+      playing[i] = 0;
+      --running;
+      if(next < config.games) {
+        start(i);
+      }
+    }
+  }
+}
+
+// Whether game i of the pack is in the same state as game, bar the
+// cells.  Those only change when a piece locks or the game ends, so
+// they are compared separately, by sameCells.
+static bool sameState(const LockstepGames& pack, int i, const StandardGame& game)
+{
+  if(pack.isGameOver(i) != game.isGameOver() || pack.getScore(i) != game.getScore()
+     || pack.getLinesCleared(i) != game.getLinesCleared()
+     || pack.getPieceCount(i) != game.getPieceCount()) {
+    return false;
+  }
+  for(int k = 0; k < game.getPreviewLength(); ++k) {
+    if(pack.getPreview(i, k) != game.getPreview(k)) {
+      return false;
+    }
+  }
+  return game.isGameOver()
+    || (pack.getPiece(i).getShape() == game.getPiece().getShape()
+        && pack.getPiece(i).getOrientationIndex() == game.getPiece().getOrientationIndex()
+        && pack.getPieceX(i) == game.getPieceX() && pack.getPieceY(i) == game.getPieceY());
+}
+
+static bool sameCells(const LockstepGames& pack, int i, const StandardGame& game,
+                      std::vector<uint8_t>& cells)
+{
+  pack.getOccupancy(i, &cells[0]);
+  for(int r = 0; r < LockstepGames::ROWS; ++r) {
+    for(int c = 0; c < LockstepGames::WIDTH; ++c) {
+      if(cells[ r * LockstepGames::WIDTH + c ] != (game.getBoard().get(r, c) != -1)
+         || pack.get(i, r, c) != game.get(r, c)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Ticks a game may last in checkLockstep when the batch sets no limit;
+// the placement policy would otherwise play on for a very long time.
+enum { CHECK_TICKS = 2000 };
+
+// Play the batch again with the placement policy, so that rows are
+// cleared and levels go up, each lane beside a StandardGame given the
+// same actions, and compare every game after every step: its piece,
+// preview, score and results, and its cells whenever a piece has
+// locked.  Returns the number of games that went differently.  Adds
+// the lines cleared to lines.
+static long checkLockstep(const BatchConfig& config, int lanes, long& lines)
+{
+  const long limit = config.maxTicks > 0 ? config.maxTicks : long(CHECK_TICKS);
+
+  LockstepGames pack(lanes);
+  pack.setRandomiser(config.randomiser);
+  std::vector<StandardGame> games(lanes, StandardGame(10, 20));
+  std::vector<BasicPlacementPolicy<10, 20> > policies(lanes);
+  std::vector<long> ticks(lanes, 0);
+  std::vector<char> playing(lanes, 0);
+  std::vector<char> failed(lanes, 0);
+  std::vector<Action> actions(lanes, ACTION_NONE);
+  std::vector<int> results(lanes);
+  std::vector<uint8_t> cells(LockstepGames::ROWS * LockstepGames::WIDTH);
+  long next = 0;
+  long differed = 0;
+  int running = 0;
+
+  auto start = [&](int i) {
+    uint64_t seed = streamSeed(config.seed, next++);
+    pack.reset(i, seed);
+    games[i].setRandomiser(config.randomiser);
+    games[i].reset(seed);
+    policies[i].reset();
+    ticks[i] = 0;
+    playing[i] = 1;
+    failed[i] = 0;
+    ++running;
+  };
+
+  for(int i = 0; i < lanes && next < config.games; ++i) {
+    start(i);
+  }
+
+  while(running > 0) {
+    for(int i = 0; i < lanes; ++i) {
+      actions[i] = playing[i] ? policies[i].nextAction(games[i]) : ACTION_NONE;
+    }
+    pack.step(&actions[0], &results[0]);
+
+    for(int i = 0; i < lanes; ++i) {
+      if(!playing[i]) {
+        continue;
+      }
+      const int pieces = games[i].getPieceCount();
+      applyAction(games[i], actions[i]);
+      const int result = games[i].tick();
+
+      if(result != results[i] || !sameState(pack, i, games[i])
+         || ((games[i].getPieceCount() != pieces || result < 0)
+             && !sameCells(pack, i, games[i], cells))) {
+        failed[i] = 1;
+      }
+      if(result >= 0 && !failed[i] && ++ticks[i] < limit) {
+        continue;
+      }
+
+      differed += failed[i];
+      lines += games[i].getLinesCleared();
+      playing[i] = 0;
+      --running;
+      if(next < config.games) {
+        start(i);
+      }
+    }
+  }
+  return differed;
+}
+
+static int compareLockstep(const BatchConfig& config, int lanes)
+{
+  if(config.width != LockstepGames::WIDTH || config.height != LockstepGames::HEIGHT
+     || lanes < 1) {
+    std::cerr << "lockstep games need a 10x20 well and at least one lane" << std::endl;
+    return 1;
+  }
+
+  SimStats single;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  playStandard(config, single);
+  double singleSecs = secondsSince(start);
+
+  SimStats lockstep;
+  start = std::chrono::steady_clock::now();
+  playLockstep(config, lanes, lockstep);
+  double lockstepSecs = secondsSince(start);
+
+  long placedLines = 0;
+  long differed = checkLockstep(config, lanes, placedLines);
+
+  bool same = single.games == lockstep.games && single.ticks == lockstep.ticks
+    && single.pieces == lockstep.pieces && single.lines == lockstep.lines
+    && single.score == lockstep.score && differed == 0;
+
+  std::cout << "games:      " << single.games << std::endl
+            << "ticks:      " << single.ticks << std::endl
+            << "pieces:     " << single.pieces << std::endl
+            << "lines:      " << single.lines << std::endl
+            << "mean score: " << double(single.score) / std::max(single.games, 1L) << std::endl
+            << "lanes:      " << lanes << " (" << LockstepGames::getVectorWidth()
+            << " per instruction)" << std::endl
+            << "one game:   " << single.ticks / singleSecs << " ticks/sec" << std::endl
+            << "lockstep:   " << lockstep.ticks / lockstepSecs << " ticks/sec" << std::endl
+            << "speedup:    " << singleSecs / lockstepSecs << std::endl
+            << "placed:     " << placedLines << " lines, " << differed
+            << " games differed" << std::endl
+            << "identical:  " << (same ? "yes" : "no") << std::endl;
+  return same ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+  BatchConfig config;
+  std::string policyName = "random";
+  std::string randomiserName = "uniform";
+  std::string script = "lldrrdcdwd";
+  std::string recordPath;
+  std::string playPath;
+  long seekEvent = -1;
+  int lanes = 0;
+
+  for(int i = 1; i < argc; ++i) {
+    if(i + 1 >= argc) {
+      usage(argv[0]);
+    }
+
+    const char *arg = argv[i];
+    const char *val = argv[++i];
+    if(!strcmp(arg, "-n")) {
+      config.games = atol(val);
+    } else if(!strcmp(arg, "-p")) {
+      policyName = val;
+    } else if(!strcmp(arg, "-s")) {
+      policyName = "script";
+      script = val;
+    } else if(!strcmp(arg, "-S")) {
+      config.seed = strtoull(val, 0, 10);
+    } else if(!strcmp(arg, "-r")) {
+      randomiserName = val;
+    } else if(!strcmp(arg, "-t")) {
+      config.maxTicks = atol(val);
+    } else if(!strcmp(arg, "-w")) {
+      config.width = atoi(val);
+    } else if(!strcmp(arg, "-h")) {
+      config.height = atoi(val);
+    } else if(!strcmp(arg, "-j")) {
+      config.threads = atoi(val);
+    } else if(!strcmp(arg, "-R")) {
+      recordPath = val;
+    } else if(!strcmp(arg, "-P")) {
+      playPath = val;
+    } else if(!strcmp(arg, "-k")) {
+      seekEvent = atol(val);
+    } else if(!strcmp(arg, "-L")) {
+      lanes = atoi(val);
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  if(policyName != "random" && policyName != "script" && policyName != "place") {
+    usage(argv[0]);
+  }
+  if(randomiserName != "uniform" && randomiserName != "bag") {
+    usage(argv[0]);
+  }
+  config.randomiser = (randomiserName == "bag") ? Game::BAG7 : Game::UNIFORM;
+
+  if(!playPath.empty()) {
+    return playReplay(playPath, seekEvent);
+  }
+
+  if(lanes) {
+    if(policyName != "random") {
+      usage(argv[0]);
+    }
+    return compareLockstep(config, lanes);
+  }
+
+  auto makePolicy = [&](int) -> Policy* {
+    if(policyName == "random") {
+      return new RandomPolicy(0);
+    }
+    if(policyName == "place") {
+      return new PlacementPolicy;
+    }
+    return new ScriptedPolicy(script);
+  };
+
+  if(!recordPath.empty()) {
+    return recordGame(config, makePolicy(0), recordPath);
+  }
+
+  BatchRunner runner(config, makePolicy);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  SimStats stats = runner.run();
+
+  double secs = secondsSince(start);
+
+  std::cout << "games:      " << stats.games << std::endl
+            << "ticks:      " << stats.ticks << std::endl
+            << "pieces:     " << stats.pieces << std::endl
+            << "lines:      " << stats.lines << std::endl
+            << "mean score: " << double(stats.score) / std::max(stats.games, 1L) << std::endl
+            << "threads:    " << runner.getWorkerStats().size() << std::endl
+            << "steals:     " << runner.getSteals() << std::endl
+            << "elapsed:    " << secs << " s" << std::endl
+            << "games/sec:  " << stats.games / secs << std::endl
+            << "ticks/sec:  " << stats.ticks / secs << std::endl
+            << "lines/sec:  " << stats.lines / secs << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,224 @@
+//---------------------------------------------------------------------------
+//
+// simthread.hpp/simthread.cpp
+//
+//---------------------------------------------------------------------------
+
+#include "simthread.hpp"
+
+#include <chrono>
+
+GameSnapshot::GameSnapshot()
+  : width(0)
+  , height(0)
+  , activeCount(0)
+  , activeColour(-1)
+  , score(0)
+  , linesCleared(0)
+  , gameOver(false)
+  , gameSpeed(SimThread::DEFAULT_GAME_SPEED)
+  , stackVersion(0)
+  , tickCount(0)
+  , tickLate(0)
+  , inputCount(0)
+  , inputTime(0)
+{}
+
+bool GameSnapshot::isActive(int r, int c) const
+{
+  for(int i = 0; i < activeCount; ++i) {
+    if(active[i][0] == r && active[i][1] == c) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int GameSnapshot::get(int r, int c) const
+{
+  return isActive(r, c) ? activeColour : board.get(r, c);
+}
+
+SimThread::SimThread(uint64_t seed, int gameSpeed)
+  : game_(StandardGame::WIDTH, StandardGame::HEIGHT, seed)
+  , gameSpeed_(gameSpeed)
+  , stackVersion_(0)
+  , tickCount_(0)
+  , inputCount_(0)
+  , inputTime_(0)
+  , stopping_(false)
+{
+  game_.setJournalEnabled(true);
+
+  // Readers have a complete snapshot from the start
+  publish();
+  snapshots_.update();
+}
+
+SimThread::~SimThread()
+{
+  stop();
+}
+
+int64_t SimThread::interval(int gameSpeed)
+{
+  return int64_t(gameSpeed) * 1000;
+}
+
+int64_t SimThread::now()
+{
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void SimThread::start(const std::function<void()>& published)
+{
+  if(thread_.joinable()) {
+    return;
+  }
+  published_ = published;
+  stopping_ = false;
+  thread_ = std::thread(&SimThread::run, this);
+}
+
+void SimThread::stop()
+{
+  if(!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+bool SimThread::post(const SimEvent& event)
+{
+  bool queued = events_.push(event);
+
+  // Taking the lock, however briefly, means the simulation thread is
+  // either still before its check of the queue or already asleep, so
+  // the wake-up cannot fall between the two.
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex_);
+  }
+  wake_.notify_one();
+  return queued;
+}
+
+void SimThread::handle(const SimEvent& event)
+{
+  switch(event.type) {
+  case SimEvent::ACTION:
+    if(applyAction(game_, Action(event.value))) {
+      ++inputCount_;
+      inputTime_ = event.time;
+    }
+    break;
+  case SimEvent::NEW_GAME:
+    game_.reset();
+    gameSpeed_ = event.value;
+    scheduler_.start(now(), interval(gameSpeed_));
+    break;
+  case SimEvent::SET_SPEED:
+    // Keeps the phase of the row the piece is part way through
+    gameSpeed_ = event.value;
+    scheduler_.setInterval(now(), interval(gameSpeed_));
+    break;
+  }
+}
+
+void SimThread::tick(int64_t now)
+{
+  ++tickCount_;
+  game_.tick();
+
+  // Every ten lines the game gets faster, down to a limit
+  if(game_.getLinesCleared() / 10 > (DEFAULT_GAME_SPEED - gameSpeed_) / 50 && gameSpeed_ > 75) {
+    gameSpeed_ -= 50;
+    scheduler_.setInterval(now, interval(gameSpeed_));
+  }
+}
+
+void SimThread::publish()
+{
+  const ChangeSet& changes = game_.getChanges();
+  if(changes.spawned || !changes.clearedRows.empty() || changes.gameOver || changes.everything) {
+    ++stackVersion_;
+  }
+  game_.clearChanges();
+
+  GameSnapshot& s = snapshots_.back();
+
+  // A fixed-size board copies without allocating
+  s.width = game_.getWidth();
+  s.height = game_.getHeight();
+  s.board = game_.getBoard();
+
+  s.activeCount = 0;
+  s.activeColour = -1;
+  if(!game_.isGameOver()) {
+    const Piece& p = game_.getPiece();
+    const PieceOrientation& o = p.getOrientation();
+    for(int i = 0; i < 4; ++i) {
+      s.active[i][0] = game_.getPieceY() - o.cells[i][0];
+      s.active[i][1] = game_.getPieceX() + o.cells[i][1];
+    }
+    s.activeCount = 4;
+    s.activeColour = p.getColourIndex();
+  }
+
+  s.score = game_.getScore();
+  s.linesCleared = game_.getLinesCleared();
+  s.gameOver = game_.isGameOver();
+  s.gameSpeed = gameSpeed_;
+  s.stackVersion = stackVersion_;
+  s.tickCount = tickCount_;
+  s.tickLate = scheduler_.getLateness();
+  s.inputCount = inputCount_;
+  s.inputTime = inputTime_;
+
+  snapshots_.publish();
+}
+
+void SimThread::run()
+{
+  scheduler_.start(now(), interval(gameSpeed_));
+
+  while(!stopping_) {
+    unsigned ticks = tickCount_;
+    int speed = gameSpeed_;
+
+    SimEvent event;
+    while(events_.pop(event)) {
+      handle(event);
+    }
+
+    // A tick for every deadline that has passed; at short intervals
+    // that can be several rows at once
+    int64_t t = now();
+    while(!game_.isGameOver() && scheduler_.next(t)) {
+      tick(t);
+    }
+
+    if(!game_.getChanges().empty() || tickCount_ != ticks || gameSpeed_ != speed) {
+      publish();
+      if(published_) {
+        published_();
+      }
+    }
+
+    // Sleep until the next deadline, or until an event arrives.  A
+    // finished game has no deadline.
+    std::unique_lock<std::mutex> lock(sleepMutex_);
+    if(game_.isGameOver()) {
+      wake_.wait(lock, [this] { return stopping_ || !events_.empty(); });
+    } else {
+      std::chrono::steady_clock::time_point until =
+        std::chrono::steady_clock::time_point() + std::chrono::microseconds(scheduler_.getDeadline());
+      wake_.wait_until(lock, until, [this] { return stopping_ || !events_.empty(); });
+    }
+  }
+}
@@ -0,0 +1,159 @@
+//---------------------------------------------------------------------------
+//
+// simthread.hpp/simthread.cpp
+//
+// Runs a StandardGame on a thread of its own, so that gravity and input
+// keep their timing however long the user interface takes to draw a
+// frame.  Events go to the game through a lock-free queue, stamped with
+// the time they happened.  What the game looks like comes back as
+// immutable snapshots through a triple buffer, so the reader always
+// gets the latest complete state without waiting for the simulation.
+// Nothing here depends on gtkmm or OpenGL.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_SIMTHREAD_HPP
+#define CS488_SIMTHREAD_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "game.hpp"
+#include "sim.hpp"
+#include "spscqueue.hpp"
+#include "tickscheduler.hpp"
+#include "triplebuffer.hpp"
+
+// Everything a frame needs to show the game, as of one moment.
+struct GameSnapshot
+{
+  // The board of the game SimThread runs, sized at compile time
+  typedef StandardGame::BoardType BoardType;
+
+  GameSnapshot();
+
+  // Size of the well.  The board has four more rows above it.
+  int width;
+  int height;
+
+  // The locked cells only
+  BoardType board;
+
+  // The falling piece, as well cells, if there is one
+  int activeCount;
+  int activeColour;
+  int active[4][2];
+
+  int score;
+  int linesCleared;
+  bool gameOver;
+
+  // Milliseconds per gravity row at the current level
+  int gameSpeed;
+
+  // Goes up whenever the locked cells change, so that anything built
+  // from them knows when to rebuild.
+  unsigned stackVersion;
+
+  // The most recent tick, and how many microseconds after its deadline
+  // it ran.
+  unsigned tickCount;
+  int64_t tickLate;
+
+  // The most recent input that changed the game, and the time it was
+  // stamped with.
+  unsigned inputCount;
+  int64_t inputTime;
+
+  // The colour at a well cell, falling piece included, or -1.
+  int get(int r, int c) const;
+  bool isActive(int r, int c) const;
+};
+
+struct SimEvent
+{
+  enum Type {
+    ACTION,     // value is an Action
+    NEW_GAME,   // value is the starting game speed
+    SET_SPEED   // value is the game speed, in milliseconds per row
+  };
+
+  Type type;
+  int value;
+
+  // When the event happened, for measuring latency.  Any clock will
+  // do; it only comes back in GameSnapshot::inputTime.
+  int64_t time;
+};
+
+class SimThread
+{
+public:
+  // The level-one speed, in milliseconds per row, that the level-up
+  // rule counts down from.
+  enum { DEFAULT_GAME_SPEED = 500 };
+
+  // A standard-sized game, dealt from seed, starting at gameSpeed.
+  SimThread(uint64_t seed, int gameSpeed);
+  ~SimThread();
+
+  // Start the thread.  published is called on the simulation thread
+  // each time a new snapshot is available; it should do no more than
+  // wake up whoever reads them.
+  void start(const std::function<void()>& published);
+  void stop();
+
+  // From the one thread that sends events.  Returns false if the queue
+  // was full and the event was dropped.
+  bool post(const SimEvent& event);
+
+  // From the one thread that reads snapshots: pick up the latest, and
+  // return whether it is new.
+  bool update()
+  {
+    return snapshots_.update();
+  }
+  const GameSnapshot& getSnapshot() const
+  {
+    return snapshots_.front();
+  }
+
+private:
+  void run();
+  void handle(const SimEvent& event);
+  void tick(int64_t now);
+
+  // Milliseconds per row to microseconds per tick
+  static int64_t interval(int gameSpeed);
+  void publish();
+
+  // Microseconds on the monotonic clock used for tick deadlines.
+  static int64_t now();
+
+  StandardGame game_;
+  int gameSpeed_;
+  TickScheduler scheduler_;
+
+  // State carried into every snapshot
+  unsigned stackVersion_;
+  unsigned tickCount_;
+  unsigned inputCount_;
+  int64_t inputTime_;
+
+  SpscQueue<SimEvent, 256> events_;
+  TripleBuffer<GameSnapshot> snapshots_;
+  std::function<void()> published_;
+
+  // Only for sleeping until the next deadline or event; the queue
+  // itself needs no lock.
+  std::mutex sleepMutex_;
+  std::condition_variable wake_;
+
+  std::atomic<bool> stopping_;
+  std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,71 @@
+//---------------------------------------------------------------------------
+//
+// spscqueue.hpp
+//
+// A bounded lock-free queue for exactly one producer thread and one
+// consumer thread.  Each side owns one index and only reads the other's,
+// so a push or pop is a couple of atomic loads and one store.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_SPSCQUEUE_HPP
+#define CS488_SPSCQUEUE_HPP
+
+#include <atomic>
+
+// N must be a power of two; the queue holds up to N - 1 items.
+template<typename T, unsigned N>
+class SpscQueue
+{
+public:
+  SpscQueue()
+    : head_(0)
+    , tail_(0)
+  {}
+
+  // Producer side.  Returns false, dropping the item, if the queue is
+  // full.
+  bool push(const T& item)
+  {
+    unsigned tail = tail_.load(std::memory_order_relaxed);
+    unsigned next = (tail + 1) & (N - 1);
+    if(next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    items_[tail] = item;
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side.  Returns false if the queue is empty.
+  bool pop(T& item)
+  {
+    unsigned head = head_.load(std::memory_order_relaxed);
+    if(head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items_[head];
+    head_.store((head + 1) & (N - 1), std::memory_order_release);
+    return true;
+  }
+
+  // Either side; only a hint while the other side is running.
+  bool empty() const
+  {
+    return head_.load(std::memory_order_acquire)
+      == tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+  T items_[N];
+
+  // The indices sit on separate cache lines, so the two threads do not
+  // keep stealing one line from each other.
+  std::atomic<unsigned> head_;
+  char padding_[64];
+  std::atomic<unsigned> tail_;
+};
+
+#endif
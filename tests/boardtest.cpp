@@ -0,0 +1,109 @@
+//---------------------------------------------------------------------------
+//
+// boardtest.cpp
+//
+// Fit tests against the right wall of wells whose width is a multiple
+// of the row word, where a piece's box reaches past the last word of
+// the row.  Best run built with -fsanitize=address, which also catches
+// reads past the row.
+//
+//---------------------------------------------------------------------------
+
+#include <stdio.h>
+
+#include "game.hpp"
+#include "random.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if(!(cond)) { \
+      fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures; \
+    } \
+  } while(0)
+
+// Whether p fits at (x, y), cell by cell.
+static bool fitsByCells(const Board& board, const Piece& p, int x, int y)
+{
+  for(int r = 0; r < 4; ++r) {
+    for(int c = 0; c < 4; ++c) {
+      if(!p.isOn(r, c)) {
+        continue;
+      }
+      int br = y - r;
+      int bc = x + c;
+      if(br < 0 || br >= board.getRows() || bc < 0 || bc >= board.getWidth() ||
+         board.get(br, bc) != -1) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void checkRightWall(int width, int rows)
+{
+  Board board(width, rows);
+  Random rng(width);
+  for(int r = 0; r < rows - 4; ++r) {
+    for(int c = width - 8; c < width; ++c) {
+      if(rng.below(3) == 0) {
+        board.set(r, c, 0);
+      }
+    }
+  }
+
+  // Every piece, in every orientation, at every column whose box
+  // reaches the last word, and every row, including the top one.
+  for(int s = 0; s < Piece::NUM_SHAPES; ++s) {
+    for(int o = 0; o < Piece::NUM_ORIENTATIONS; ++o) {
+      const Piece p(s, o);
+      for(int x = width - 8; x < width; ++x) {
+        for(int y = 0; y < rows; ++y) {
+          CHECK(board.fits(p, x, y) == fitsByCells(board, p, x, y));
+        }
+      }
+    }
+  }
+}
+
+static void checkPlacements(int width)
+{
+  Game game(width, 20, 1);
+  std::vector<Game::PlacementType> placements;
+  for(int i = 0; i < 200 && !game.isGameOver(); ++i) {
+    game.getPlacements(placements);
+    CHECK(!placements.empty());
+    if(placements.empty()) {
+      return;
+    }
+
+    // Stack pieces against the right wall.
+    const Game::PlacementType* right = &placements[0];
+    for(size_t k = 1; k < placements.size(); ++k) {
+      if(placements[k].x > right->x) {
+        right = &placements[k];
+      }
+    }
+    CHECK(right->x + 3 - right->piece.getRightMargin() == width - 1);
+    game.applyPlacement(*right);
+  }
+}
+
+int main()
+{
+  checkRightWall(64, 24);
+  checkRightWall(128, 24);
+  checkRightWall(192, 8);
+  checkPlacements(64);
+  checkPlacements(128);
+
+  if(failures) {
+    fprintf(stderr, "boardtest: %d failures\n", failures);
+    return 1;
+  }
+  printf("boardtest: passed\n");
+  return 0;
+}
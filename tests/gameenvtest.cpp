@@ -0,0 +1,177 @@
+//---------------------------------------------------------------------------
+//
+// gameenvtest.cpp
+//
+// Drives a batch of games through the C interface in gameenv.h and
+// checks every observation in the buffer against StandardGames given
+// the same seeds and actions, played to clear rows, through game overs
+// and resets.
+//
+//---------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "gameenv.h"
+#include "game.hpp"
+#include "random.hpp"
+#include "sim.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if(!(cond)) { \
+      fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures; \
+    } \
+  } while(0)
+
+enum {
+  GAMES = 50,
+  PREVIEW = 4,
+  STEPS = 3000
+};
+
+static const uint64_t SEED = 7;
+
+// Whether the falling piece of game covers the cell at row r, column c.
+static bool inPiece(const StandardGame& game, int r, int c)
+{
+  int pr = game.getPieceY() - r;
+  int pc = c - game.getPieceX();
+  return pr >= 0 && pr < 4 && pc >= 0 && pc < 4 && game.getPiece().isOn(pr, pc);
+}
+
+static void checkGame(const unsigned char* buffer, const GameEnvLayout& l,
+                      int i, const StandardGame& game)
+{
+  const int32_t* piece = (const int32_t*)(buffer + l.piece) + i * 4;
+  if(!game.isGameOver()) {
+    CHECK(piece[0] == game.getPiece().getShape());
+    CHECK(piece[1] == game.getPiece().getOrientationIndex());
+    CHECK(piece[2] == game.getPieceX());
+    CHECK(piece[3] == game.getPieceY());
+  }
+
+  const int32_t* preview = (const int32_t*)(buffer + l.preview) + i * l.preview_length;
+  for(int k = 0; k < l.preview_length; ++k) {
+    CHECK(preview[k] == game.getPreview(k));
+  }
+
+  CHECK(((const int32_t*)(buffer + l.score))[i] == game.getScore());
+  CHECK(((const int32_t*)(buffer + l.lines))[i] == game.getLinesCleared());
+  CHECK(buffer[l.done + i] == (game.isGameOver() ? 1 : 0));
+
+  // The board plane leaves out the falling piece, which get() lays over
+  // the well.
+  const unsigned char* board = buffer + l.board + i * l.rows * l.width;
+  for(int r = 0; r < l.rows; ++r) {
+    for(int c = 0; c < l.width; ++c) {
+      if(!game.isGameOver() && inPiece(game, r, c)) {
+        continue;
+      }
+      CHECK(board[r * l.width + c] == (game.get(r, c) != -1 ? 1 : 0));
+    }
+  }
+}
+
+int main()
+{
+  CHECK(env_create(0, GAME_ENV_BAG7, PREVIEW, SEED) == 0);
+  CHECK(env_create(GAMES, 2, PREVIEW, SEED) == 0);
+
+  GameEnv* env = env_create(GAMES, GAME_ENV_BAG7, PREVIEW, SEED);
+  CHECK(env != 0);
+  if(!env) {
+    return 1;
+  }
+
+  GameEnvLayout l;
+  env_layout(env, &l);
+  CHECK(l.games == GAMES);
+  CHECK(l.rows == 24 && l.width == 10);
+  CHECK(l.preview_length == PREVIEW);
+
+  // Every field starts on a 64-byte boundary, in order, and fits.
+  const uint64_t offsets[] = { l.board, l.piece, l.preview, l.score, l.lines, l.done, l.size };
+  for(int k = 0; k < 7; ++k) {
+    CHECK(offsets[k] % 64 == 0);
+  }
+  CHECK(l.piece >= l.board + uint64_t(GAMES) * l.rows * l.width);
+  CHECK(l.preview >= l.piece + uint64_t(GAMES) * 4 * sizeof(int32_t));
+  CHECK(l.score >= l.preview + uint64_t(GAMES) * PREVIEW * sizeof(int32_t));
+  CHECK(l.lines >= l.score + uint64_t(GAMES) * sizeof(int32_t));
+  CHECK(l.done >= l.lines + uint64_t(GAMES) * sizeof(int32_t));
+  CHECK(l.size >= l.done + uint64_t(GAMES));
+
+  std::vector<uint64_t> storage(l.size / 8 + 1);
+  unsigned char* buffer = (unsigned char*)&storage[0];
+  CHECK(env_attach(env, buffer, l.size - 1) == -1);
+  CHECK(env_attach(env, buffer + 1, l.size) == -1);
+  CHECK(env_attach(env, buffer, l.size) == 0);
+
+  std::vector<StandardGame> games(GAMES, StandardGame(10, 20));
+  for(int i = 0; i < GAMES; ++i) {
+    games[i].setRandomiser(GameTypes::BAG7);
+    games[i].setPreviewLength(PREVIEW);
+    games[i].reset(streamSeed(SEED, i));
+    checkGame(buffer, l, i, games[i]);
+  }
+
+  std::vector<int32_t> actions(GAMES);
+  CHECK(env_step(env, &actions[0], GAMES - 1) == -1);
+
+  std::vector<BasicPlacementPolicy<10, 20> > policies(GAMES);
+  Random rng(1);
+  int resets = 0;
+  long lines = 0;
+  for(int t = 0; t < STEPS && !failures; ++t) {
+    for(int i = 0; i < GAMES; ++i) {
+      // Mostly the placement policy's moves, so that rows clear; now
+      // and then a random one, or one the interface must ignore.
+      switch(rng.below(16)) {
+        case 0:
+          actions[i] = rng.below(2) ? -1 : NUM_ACTIONS;
+          break;
+        case 1:
+          actions[i] = rng.below(NUM_ACTIONS);
+          break;
+        default:
+          actions[i] = policies[i].nextAction(games[i]);
+          break;
+      }
+      if(!games[i].isGameOver()) {
+        if(actions[i] >= 0 && actions[i] < NUM_ACTIONS) {
+          applyAction(games[i], Action(actions[i]));
+        }
+        games[i].tick();
+      }
+    }
+    CHECK(env_step(env, &actions[0], GAMES) == 0);
+
+    for(int i = 0; i < GAMES; ++i) {
+      checkGame(buffer, l, i, games[i]);
+      if(games[i].isGameOver()) {
+        lines += games[i].getLinesCleared();
+        const uint64_t seed = uint64_t(t) * GAMES + i;
+        env_reset(env, i, seed);
+        games[i].reset(seed);
+        policies[i].reset();
+        checkGame(buffer, l, i, games[i]);
+        ++resets;
+      }
+    }
+  }
+  CHECK(resets > 0 && lines > 0);
+
+  env_destroy(env);
+
+  if(failures) {
+    fprintf(stderr, "gameenvtest: %d failures\n", failures);
+    return 1;
+  }
+  printf("gameenvtest: passed, %d games, %ld lines\n", resets, lines);
+  return 0;
+}
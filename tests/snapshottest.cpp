@@ -0,0 +1,159 @@
+//---------------------------------------------------------------------------
+//
+// snapshottest.cpp
+//
+// Steps games ahead and back with an UndoStack and checks that every
+// pop puts the game back exactly, that copies of a game go their own
+// way once either changes, and that a stack made up front allocates
+// nothing while it is used.
+//
+//---------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <vector>
+
+#include "random.hpp"
+#include "sim.hpp"
+#include "undostack.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if(!(cond)) { \
+      fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); \
+      ++failures; \
+    } \
+  } while(0)
+
+// Every allocation, so that the test can see there are none.
+static long allocations = 0;
+
+void* operator new(size_t size)
+{
+  ++allocations;
+  void* p = malloc(size ? size : 1);
+  if(!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+enum {
+  DEPTH = 40,
+  ROUNDS = 500
+};
+
+template<typename G>
+static void step(G& game, Random& rng)
+{
+  applyAction(game, Action(rng.below(NUM_ACTIONS)));
+  if(game.tick() < 0) {
+    game.reset();
+  }
+}
+
+template<typename G>
+static void checkUndo(G game, const char* name)
+{
+  std::vector<unsigned char> before;
+  std::vector<unsigned char> after;
+  before.reserve(1 << 16);
+  after.reserve(1 << 16);
+
+  game.setRandomiser(GameTypes::BAG7);
+  game.setPreviewLength(4);
+  UndoStack<G> undo(game, DEPTH);
+  Random rng(1);
+
+  const long start = allocations;
+  for(int round = 0; round < ROUNDS; ++round) {
+    before.clear();
+    game.saveState(before);
+
+    for(int d = 0; d < DEPTH; ++d) {
+      undo.push(game);
+      step(game, rng);
+    }
+    CHECK(undo.size() == DEPTH);
+    for(int d = 0; d < DEPTH - 1; ++d) {
+      CHECK(undo.pop(game));
+    }
+    CHECK(undo.peek(game));
+    step(game, rng);
+    CHECK(undo.pop(game));
+    CHECK(undo.empty());
+    CHECK(!undo.pop(game));
+
+    after.clear();
+    game.saveState(after);
+    CHECK(before == after);
+
+    step(game, rng);
+  }
+
+  if(allocations != start) {
+    fprintf(stderr, "%s: %ld allocations\n", name, allocations - start);
+    ++failures;
+  }
+}
+
+// A copy shares the board, then each side's changes stay its own.
+template<typename G>
+static void checkCopies(G game)
+{
+  Random rng(2);
+  for(int t = 0; t < 300; ++t) {
+    step(game, rng);
+  }
+
+  std::vector<unsigned char> original;
+  game.saveState(original);
+
+  G copy(game);
+  for(int t = 0; t < 300; ++t) {
+    step(copy, rng);
+  }
+  std::vector<unsigned char> state;
+  game.saveState(state);
+  CHECK(state == original);
+
+  G assigned(game);
+  assigned = copy;
+  for(int t = 0; t < 300; ++t) {
+    step(game, rng);
+  }
+  std::vector<unsigned char> copied;
+  copy.saveState(copied);
+  state.clear();
+  assigned.saveState(state);
+  CHECK(state == copied);
+}
+
+int main()
+{
+  checkUndo(StandardGame(10, 20, 3), "StandardGame");
+  checkUndo(Game(10, 20, 3), "Game 10x20");
+  checkUndo(Game(128, 30, 3), "Game 128x30");
+  checkCopies(StandardGame(10, 20, 4));
+  checkCopies(Game(100, 20, 4));
+
+  if(failures) {
+    fprintf(stderr, "snapshottest: %d failures\n", failures);
+    return 1;
+  }
+  printf("snapshottest: passed\n");
+  return 0;
+}
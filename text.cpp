@@ -0,0 +1,251 @@
+//---------------------------------------------------------------------------
+//
+// text.hpp/text.cpp
+//
+//---------------------------------------------------------------------------
+
+#define GL_GLEXT_PROTOTYPES
+#include "text.hpp"
+#include <GL/glext.h>
+
+#include <ctype.h>
+#include <stddef.h>
+
+// Size of the font texture.  Characters 32 to 127 sit in a 16 by 6
+// grid of cells, starting at the top left.
+#define ATLAS_WIDTH 128
+#define ATLAS_HEIGHT 64
+#define ATLAS_COLUMNS 16
+
+// Character 127 is a solid block, used for rectangles.
+#define SOLID_CHAR 127
+
+struct Glyph
+{
+  char c;
+  const char *rows[7];
+};
+
+static const Glyph FONT[] = {
+  { '0', { " ### ", "#   #", "#  ##", "# # #", "##  #", "#   #", " ### " } },
+  { '1', { "  #  ", " ##  ", "  #  ", "  #  ", "  #  ", "  #  ", " ### " } },
+  { '2', { " ### ", "#   #", "    #", "   # ", "  #  ", " #   ", "#####" } },
+  { '3', { "#####", "   # ", "  #  ", "   # ", "    #", "#   #", " ### " } },
+  { '4', { "   # ", "  ## ", " # # ", "#  # ", "#####", "   # ", "   # " } },
+  { '5', { "#####", "#    ", "#### ", "    #", "    #", "#   #", " ### " } },
+  { '6', { "  ## ", " #   ", "#    ", "#### ", "#   #", "#   #", " ### " } },
+  { '7', { "#####", "    #", "   # ", "  #  ", " #   ", " #   ", " #   " } },
+  { '8', { " ### ", "#   #", "#   #", " ### ", "#   #", "#   #", " ### " } },
+  { '9', { " ### ", "#   #", "#   #", " ####", "    #", "   # ", " ##  " } },
+  { 'A', { " ### ", "#   #", "#   #", "#####", "#   #", "#   #", "#   #" } },
+  { 'B', { "#### ", "#   #", "#   #", "#### ", "#   #", "#   #", "#### " } },
+  { 'C', { " ### ", "#   #", "#    ", "#    ", "#    ", "#   #", " ### " } },
+  { 'D', { "###  ", "#  # ", "#   #", "#   #", "#   #", "#  # ", "###  " } },
+  { 'E', { "#####", "#    ", "#    ", "#### ", "#    ", "#    ", "#####" } },
+  { 'F', { "#####", "#    ", "#    ", "#### ", "#    ", "#    ", "#    " } },
+  { 'G', { " ### ", "#   #", "#    ", "# ###", "#   #", "#   #", " ####" } },
+  { 'H', { "#   #", "#   #", "#   #", "#####", "#   #", "#   #", "#   #" } },
+  { 'I', { " ### ", "  #  ", "  #  ", "  #  ", "  #  ", "  #  ", " ### " } },
+  { 'J', { "  ###", "   # ", "   # ", "   # ", "   # ", "#  # ", " ##  " } },
+  { 'K', { "#   #", "#  # ", "# #  ", "##   ", "# #  ", "#  # ", "#   #" } },
+  { 'L', { "#    ", "#    ", "#    ", "#    ", "#    ", "#    ", "#####" } },
+  { 'M', { "#   #", "## ##", "# # #", "# # #", "#   #", "#   #", "#   #" } },
+  { 'N', { "#   #", "#   #", "##  #", "# # #", "#  ##", "#   #", "#   #" } },
+  { 'O', { " ### ", "#   #", "#   #", "#   #", "#   #", "#   #", " ### " } },
+  { 'P', { "#### ", "#   #", "#   #", "#### ", "#    ", "#    ", "#    " } },
+  { 'Q', { " ### ", "#   #", "#   #", "#   #", "# # #", "#  # ", " ## #" } },
+  { 'R', { "#### ", "#   #", "#   #", "#### ", "# #  ", "#  # ", "#   #" } },
+  { 'S', { " ####", "#    ", "#    ", " ### ", "    #", "    #", "#### " } },
+  { 'T', { "#####", "  #  ", "  #  ", "  #  ", "  #  ", "  #  ", "  #  " } },
+  { 'U', { "#   #", "#   #", "#   #", "#   #", "#   #", "#   #", " ### " } },
+  { 'V', { "#   #", "#   #", "#   #", "#   #", "#   #", " # # ", "  #  " } },
+  { 'W', { "#   #", "#   #", "#   #", "# # #", "# # #", "# # #", " # # " } },
+  { 'X', { "#   #", "#   #", " # # ", "  #  ", " # # ", "#   #", "#   #" } },
+  { 'Y', { "#   #", "#   #", "#   #", " # # ", "  #  ", "  #  ", "  #  " } },
+  { 'Z', { "#####", "    #", "   # ", "  #  ", " #   ", "#    ", "#####" } },
+  { '.', { "     ", "     ", "     ", "     ", "     ", " ##  ", " ##  " } },
+  { ':', { "     ", " ##  ", " ##  ", "     ", " ##  ", " ##  ", "     " } },
+  { '/', { "     ", "    #", "   # ", "  #  ", " #   ", "#    ", "     " } },
+  { '%', { "##   ", "##  #", "   # ", "  #  ", " #   ", "#  ##", "   ##" } },
+  { '-', { "     ", "     ", "     ", "#####", "     ", "     ", "     " } },
+  { '+', { "     ", "  #  ", "  #  ", "#####", "  #  ", "  #  ", "     " } },
+  { '=', { "     ", "     ", "#####", "     ", "#####", "     ", "     " } },
+  { '(', { "   # ", "  #  ", " #   ", " #   ", " #   ", "  #  ", "   # " } },
+  { ')', { " #   ", "  #  ", "   # ", "   # ", "   # ", "  #  ", " #   " } },
+  { '<', { "   # ", "  #  ", " #   ", "#    ", " #   ", "  #  ", "   # " } },
+  { '>', { " #   ", "  #  ", "   # ", "    #", "   # ", "  #  ", " #   " } }
+};
+
+static const char VERTEX_SHADER[] =
+  "#version 120\n"
+  "uniform vec2 viewport;\n"
+  "attribute vec2 position;\n"
+  "attribute vec2 texCoord;\n"
+  "attribute vec4 colour;\n"
+  "varying vec2 uv;\n"
+  "varying vec4 tint;\n"
+  "void main()\n"
+  "{\n"
+  "  uv = texCoord;\n"
+  "  tint = colour;\n"
+  "  gl_Position = vec4(position.x * 2.0 / viewport.x - 1.0,\n"
+  "                     1.0 - position.y * 2.0 / viewport.y, 0.0, 1.0);\n"
+  "}\n";
+
+static const char FRAGMENT_SHADER[] =
+  "#version 120\n"
+  "uniform sampler2D font;\n"
+  "varying vec2 uv;\n"
+  "varying vec4 tint;\n"
+  "void main()\n"
+  "{\n"
+  "  gl_FragColor = vec4(tint.rgb, tint.a * texture2D(font, uv).r);\n"
+  "}\n";
+
+static const char *const ATTRIB_NAMES[] = {
+  "position", "texCoord", "colour", 0
+};
+
+TextRenderer::TextRenderer()
+  : buffer_(0)
+  , texture_(0)
+  , scale_(2)
+  , viewportUniform_(-1)
+  , state_(0)
+{}
+
+bool TextRenderer::init(RenderState& state)
+{
+  state_ = &state;
+  if(!buffer_) {
+    // Rasterise the font into the atlas, one byte per texel
+    std::vector<GLubyte> atlas(ATLAS_WIDTH * ATLAS_HEIGHT, 0);
+    for(size_t i = 0; i < sizeof(FONT) / sizeof(FONT[0]); ++i) {
+      int cell = FONT[i].c - 32;
+      int x0 = (cell % ATLAS_COLUMNS) * CELL_WIDTH;
+      int y0 = (cell / ATLAS_COLUMNS) * CELL_HEIGHT;
+      for(int r = 0; r < 7; ++r) {
+        for(int c = 0; c < 5; ++c) {
+          if(FONT[i].rows[r][c] == '#') {
+            atlas[(y0 + r) * ATLAS_WIDTH + x0 + c] = 255;
+          }
+        }
+      }
+    }
+    int solid = SOLID_CHAR - 32;
+    for(int r = 0; r < CELL_HEIGHT; ++r) {
+      for(int c = 0; c < CELL_WIDTH; ++c) {
+        atlas[((solid / ATLAS_COLUMNS) * CELL_HEIGHT + r) * ATLAS_WIDTH
+              + (solid % ATLAS_COLUMNS) * CELL_WIDTH + c] = 255;
+      }
+    }
+
+    glGenTextures(1, &texture_);
+    state_->bindTexture(texture_);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, ATLAS_WIDTH, ATLAS_HEIGHT, 0,
+                 GL_LUMINANCE, GL_UNSIGNED_BYTE, &atlas[0]);
+
+    glGenBuffers(1, &buffer_);
+  }
+
+  if(!shader_.init(VERTEX_SHADER, FRAGMENT_SHADER, ATTRIB_NAMES)) {
+    return false;
+  }
+  viewportUniform_ = shader_.getUniform("viewport");
+  state_->useProgram(shader_.getProgram());
+  glUniform1i(shader_.getUniform("font"), 0);
+  return true;
+}
+
+void TextRenderer::quad(float x0, float y0, float x1, float y1,
+                        float u0, float v0, float u1, float v1,
+                        float r, float g, float b, float a)
+{
+  Vertex corners[4] = {
+    { { x0, y0 }, { u0, v0 }, { 0, 0, 0, 0 } },
+    { { x1, y0 }, { u1, v0 }, { 0, 0, 0, 0 } },
+    { { x1, y1 }, { u1, v1 }, { 0, 0, 0, 0 } },
+    { { x0, y1 }, { u0, v1 }, { 0, 0, 0, 0 } }
+  };
+  for(int i = 0; i < 4; ++i) {
+    corners[i].colour[0] = GLubyte(r * 255 + 0.5f);
+    corners[i].colour[1] = GLubyte(g * 255 + 0.5f);
+    corners[i].colour[2] = GLubyte(b * 255 + 0.5f);
+    corners[i].colour[3] = GLubyte(a * 255 + 0.5f);
+  }
+
+  // Two triangles, 012 and 023
+  static const int ORDER[6] = { 0, 1, 2, 0, 2, 3 };
+  for(int i = 0; i < 6; ++i) {
+    vertices_.push_back(corners[ ORDER[i] ]);
+  }
+}
+
+void TextRenderer::print(float x, float y, const char *s,
+                         float r, float g, float b)
+{
+  const float w = CELL_WIDTH * scale_;
+  const float h = CELL_HEIGHT * scale_;
+
+  for(; *s; ++s, x += w) {
+    int c = toupper((unsigned char)*s);
+    if(c <= 32 || c >= SOLID_CHAR) {
+      continue;
+    }
+    int cell = c - 32;
+    float u0 = float((cell % ATLAS_COLUMNS) * CELL_WIDTH) / ATLAS_WIDTH;
+    float v0 = float((cell / ATLAS_COLUMNS) * CELL_HEIGHT) / ATLAS_HEIGHT;
+    quad(x, y, x + w, y + h,
+         u0, v0, u0 + float(CELL_WIDTH) / ATLAS_WIDTH,
+         v0 + float(CELL_HEIGHT) / ATLAS_HEIGHT, r, g, b, 1);
+  }
+}
+
+void TextRenderer::rect(float x, float y, float width, float height,
+                        float r, float g, float b, float a)
+{
+  // Every texel of the solid cell is on, so sample its middle
+  int cell = SOLID_CHAR - 32;
+  float u = ((cell % ATLAS_COLUMNS) * CELL_WIDTH + CELL_WIDTH / 2.0f) / ATLAS_WIDTH;
+  float v = ((cell / ATLAS_COLUMNS) * CELL_HEIGHT + CELL_HEIGHT / 2.0f) / ATLAS_HEIGHT;
+  quad(x, y, x + width, y + height, u, v, u, v, r, g, b, a);
+}
+
+void TextRenderer::draw(int width, int height)
+{
+  if(vertices_.empty() || !shader_.getProgram()) {
+    return;
+  }
+
+  state_->bindArrayBuffer(buffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex),
+               &vertices_[0], GL_STREAM_DRAW);
+
+  state_->useProgram(shader_.getProgram());
+  glUniform2f(viewportUniform_, width, height);
+  state_->bindTexture(texture_);
+
+  // Overlays sit on top of everything, and let the frame show through
+  state_->disable(GL_DEPTH_TEST);
+  state_->enable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+  state_->enableAttrib(0);
+  state_->enableAttrib(1);
+  state_->enableAttrib(2);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, position));
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, texCoord));
+  glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                        (GLvoid*)offsetof(Vertex, colour));
+  glDrawArrays(GL_TRIANGLES, 0, vertices_.size());
+
+  state_->disable(GL_BLEND);
+  state_->enable(GL_DEPTH_TEST);
+}
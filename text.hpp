@@ -0,0 +1,89 @@
+//---------------------------------------------------------------------------
+//
+// text.hpp/text.cpp
+//
+// Screen-space text and solid rectangles, for overlays.  The glyphs of
+// a small built-in 5x7 bitmap font are packed into one texture, and
+// everything added between clear() and draw() goes to the GL in a
+// single draw call.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_TEXT_HPP
+#define CS488_TEXT_HPP
+
+#include <vector>
+#include <GL/gl.h>
+
+#include "renderstate.hpp"
+#include "shader.hpp"
+
+class TextRenderer
+{
+public:
+  // Size of one character cell in font pixels, spacing included.
+  enum { CELL_WIDTH = 6, CELL_HEIGHT = 8 };
+
+  TextRenderer();
+
+  // Build the font texture, the buffer and the shader program.  Call
+  // with the GL context current.  Returns false if the program cannot
+  // be built; getLog() says why.
+  bool init(RenderState& state);
+  const std::string& getLog() const
+  {
+    return shader_.getLog();
+  }
+
+  // Each font pixel becomes scale by scale screen pixels.
+  void setScale(int scale)
+  {
+    scale_ = scale;
+  }
+  int getScale() const
+  {
+    return scale_;
+  }
+
+  void clear()
+  {
+    vertices_.clear();
+  }
+
+  // Add a string with its top left corner at (x, y), in pixels from
+  // the top left of the window.  Lower case prints as upper case, and
+  // characters the font lacks print as spaces.
+  void print(float x, float y, const char *s,
+             float r = 1, float g = 1, float b = 1);
+
+  // Add a filled rectangle.
+  void rect(float x, float y, float width, float height,
+            float r, float g, float b, float a = 1);
+
+  // Draw everything added since clear(), blended over the frame, in a
+  // window of the given size.
+  void draw(int width, int height);
+
+private:
+  struct Vertex
+  {
+    GLfloat position[2];
+    GLfloat texCoord[2];
+    GLubyte colour[4];
+  };
+
+  void quad(float x0, float y0, float x1, float y1,
+            float u0, float v0, float u1, float v1,
+            float r, float g, float b, float a);
+
+  std::vector<Vertex> vertices_;
+  GLuint buffer_;
+  GLuint texture_;
+  int scale_;
+
+  ShaderProgram shader_;
+  GLint viewportUniform_;
+  RenderState *state_;
+};
+
+#endif
@@ -0,0 +1,77 @@
+//---------------------------------------------------------------------------
+//
+// tickscheduler.hpp/tickscheduler.cpp
+//
+//---------------------------------------------------------------------------
+
+#include "tickscheduler.hpp"
+
+TickScheduler::TickScheduler()
+  : interval_(1)
+  , deadline_(0)
+{
+  resetJitter();
+}
+
+void TickScheduler::start(int64_t now, int64_t interval)
+{
+  interval_ = interval > 0 ? interval : 1;
+  deadline_ = now + interval_;
+  resetJitter();
+}
+
+void TickScheduler::setInterval(int64_t now, int64_t interval)
+{
+  if(interval <= 0) {
+    interval = 1;
+  }
+  if(interval == interval_) {
+    return;
+  }
+
+  // Scale what is left of the current interval, rather than starting a
+  // new one from now
+  int64_t left = deadline_ - now;
+  if(left < 0) {
+    left = 0;
+  } else if(left > interval_) {
+    left = interval_;
+  }
+  deadline_ = now + left * interval / interval_;
+  interval_ = interval;
+}
+
+bool TickScheduler::next(int64_t now)
+{
+  if(now < deadline_) {
+    return false;
+  }
+
+  int64_t behind = (now - deadline_) / interval_;
+  if(behind > MAX_CATCH_UP) {
+    deadline_ += (behind - MAX_CATCH_UP) * interval_;
+  }
+
+  lateness_ = now - deadline_;
+  totalLateness_ += lateness_;
+  if(lateness_ > maxLateness_) {
+    maxLateness_ = lateness_;
+  }
+  ++ticks_;
+
+  deadline_ += interval_;
+  return true;
+}
+
+int64_t TickScheduler::getMeanLateness() const
+{
+  return ticks_ > 0 ? totalLateness_ / ticks_ : 0;
+}
+
+void TickScheduler::resetJitter()
+{
+  lateness_ = 0;
+  totalLateness_ = 0;
+  maxLateness_ = 0;
+  ticks_ = 0;
+}
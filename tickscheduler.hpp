@@ -0,0 +1,62 @@
+//---------------------------------------------------------------------------
+//
+// tickscheduler.hpp/tickscheduler.cpp
+//
+// Decides when game ticks are due, against a monotonic clock.  Each
+// deadline is the previous deadline plus the interval, never the time a
+// tick actually ran, so lateness in running one tick does not push back
+// the ones after it.  An interval shorter than a frame is fine: the
+// caller just gets several ticks due at once.  Times are in
+// microseconds, from whatever monotonic clock the caller uses.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_TICKSCHEDULER_HPP
+#define CS488_TICKSCHEDULER_HPP
+
+#include <stdint.h>
+
+class TickScheduler
+{
+public:
+  TickScheduler();
+
+  // Start a new schedule, with the first tick one interval after now.
+  void start(int64_t now, int64_t interval);
+
+  // Change the interval.  The fraction of the current interval that
+  // has already gone is kept, so a tick halfway through at the old
+  // rate is halfway through at the new one.
+  void setInterval(int64_t now, int64_t interval);
+
+  // Whether a tick is due by now.  If so it is taken: the deadline
+  // moves on by one interval and the tick's lateness is recorded.
+  // Call until it returns false to run every tick that is due.
+  bool next(int64_t now);
+
+  int64_t getInterval() const { return interval_; }
+  int64_t getDeadline() const { return deadline_; }
+
+  // How late ticks ran after their deadlines: the last one, and the
+  // mean and worst since resetJitter() or start().
+  int64_t getLateness() const { return lateness_; }
+  int64_t getMeanLateness() const;
+  int64_t getMaxLateness() const { return maxLateness_; }
+  void resetJitter();
+
+  // How many intervals behind the schedule may fall (the machine was
+  // suspended, say) before the missed ticks are dropped rather than
+  // all run at once.  Dropping whole intervals keeps the phase.
+  enum { MAX_CATCH_UP = 4 };
+
+private:
+  int64_t interval_;
+  int64_t deadline_;
+
+  int64_t lateness_;
+  int64_t totalLateness_;
+  int64_t maxLateness_;
+  int64_t ticks_;
+};
+
+#endif
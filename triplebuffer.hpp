@@ -0,0 +1,64 @@
+//---------------------------------------------------------------------------
+//
+// triplebuffer.hpp
+//
+// Hands the latest of a stream of values from one writer thread to one
+// reader thread without locks and without either side ever waiting.
+// The writer fills its back slot and publishes it; the reader takes the
+// most recently published slot as its front.  The third slot sits in
+// the middle, so the two sides never touch the same slot, and values
+// the reader never picked up are simply overwritten.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_TRIPLEBUFFER_HPP
+#define CS488_TRIPLEBUFFER_HPP
+
+#include <atomic>
+
+template<typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer()
+    : middle_(1)
+    , back_(2)
+    , front_(0)
+  {}
+
+  // Writer side: the slot to fill, then publish it.
+  T& back()
+  {
+    return slots_[back_];
+  }
+  void publish()
+  {
+    back_ = middle_.exchange(back_ | FRESH, std::memory_order_acq_rel) & INDEX;
+  }
+
+  // Reader side: pick up the latest published value, if there is one
+  // the reader has not seen.  Returns whether front() changed.
+  bool update()
+  {
+    if(!(middle_.load(std::memory_order_relaxed) & FRESH)) {
+      return false;
+    }
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+  const T& front() const
+  {
+    return slots_[front_];
+  }
+
+private:
+  // The middle slot index, with a flag for "published and not yet read"
+  enum { INDEX = 3, FRESH = 4 };
+
+  T slots_[3];
+  std::atomic<unsigned> middle_;
+  unsigned back_;
+  unsigned front_;
+};
+
+#endif
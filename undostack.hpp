@@ -0,0 +1,94 @@
+//---------------------------------------------------------------------------
+//
+// undostack.hpp
+//
+// A stack of snapshots of one game, for undo in analysis tools and for
+// searches that step ahead and back.  A snapshot shares the game's
+// board, so pushing and popping cost the same whatever the size of the
+// well.  Made with the game and the deepest a search goes, the stack
+// has its snapshots, and the game's pool the boards it will copy while
+// they are held, ready up front, and nothing is allocated after that.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_UNDOSTACK_HPP
+#define CS488_UNDOSTACK_HPP
+
+#include <vector>
+
+#include "game.hpp"
+
+template<typename G>
+class UndoStack
+{
+public:
+  // Room for depth snapshots is made up front.
+  explicit UndoStack(int depth = 0)
+    : snapshots_(depth)
+    , depth_(0)
+  {}
+  // The same, with room in the pool of game for the boards it copies
+  // while depth snapshots hold its old ones.
+  UndoStack(G& game, int depth)
+    : snapshots_(depth)
+    , depth_(0)
+  {
+    game.reserveBoards(depth);
+  }
+
+  int size() const
+  {
+    return depth_;
+  }
+  bool empty() const
+  {
+    return depth_ == 0;
+  }
+
+  // Save game as it is now.
+  void push(const G& game)
+  {
+    if(depth_ == int(snapshots_.size())) {
+      snapshots_.resize(depth_ + 1);
+    }
+    game.takeSnapshot(snapshots_[depth_++]);
+  }
+
+  // Put game back as it was at the last push, and forget that push.
+  // Returns false, and leaves game alone, if the stack is empty.
+  bool pop(G& game)
+  {
+    if(depth_ == 0) {
+      return false;
+    }
+    game.restore(snapshots_[--depth_]);
+    // Let go of the board, so the game can change it without a copy.
+    snapshots_[depth_].clear();
+    return true;
+  }
+
+  // Put game back as it was at the last push, keeping it on the stack
+  // to go back to again.
+  bool peek(G& game) const
+  {
+    if(depth_ == 0) {
+      return false;
+    }
+    game.restore(snapshots_[depth_ - 1]);
+    return true;
+  }
+
+  // Forget every snapshot; their storage is kept.
+  void clear()
+  {
+    while(depth_ > 0) {
+      snapshots_[--depth_].clear();
+    }
+  }
+
+private:
+  std::vector<typename G::Snapshot> snapshots_;
+  int depth_;
+};
+
+#endif // CS488_UNDOSTACK_HPP
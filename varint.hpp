@@ -0,0 +1,57 @@
+//---------------------------------------------------------------------------
+//
+// varint.hpp
+//
+// Variable-length integers for compact binary files: seven bits to a
+// byte, low bits first, the top bit set on every byte but the last.
+// Small values take one byte.  Signed values are zigzag encoded first,
+// so that small negative numbers stay small too.
+//
+//---------------------------------------------------------------------------
+
+#ifndef CS488_VARINT_HPP
+#define CS488_VARINT_HPP
+
+#include <stdint.h>
+#include <vector>
+
+inline void putVarint(std::vector<unsigned char>& out, uint64_t value)
+{
+  while(value >= 0x80) {
+    out.push_back((unsigned char)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((unsigned char)value);
+}
+
+inline void putSignedVarint(std::vector<unsigned char>& out, int64_t value)
+{
+  putVarint(out, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+}
+
+// Read a value at p and move p past it.  Returns false, leaving p where
+// it stopped, if the value runs past end or is too long.
+inline bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& value)
+{
+  value = 0;
+  for(int shift = 0; shift < 64 && p < end; shift += 7) {
+    unsigned char byte = *p++;
+    value |= uint64_t(byte & 0x7f) << shift;
+    if(!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+inline bool getSignedVarint(const unsigned char*& p, const unsigned char* end, int64_t& value)
+{
+  uint64_t u;
+  if(!getVarint(p, end, u)) {
+    return false;
+  }
+  value = int64_t(u >> 1) ^ -int64_t(u & 1);
+  return true;
+}
+
+#endif // CS488_VARINT_HPP
@@ -1,12 +1,19 @@
 #include "viewer.hpp"
 #include <iostream>
-#include <sstream>
 #include <GL/gl.h>
-#include <GL/glu.h>
 #include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <time.h>
 #include "appwindow.hpp"
 
-#define DEFAULT_GAME_SPEED 500
+// Shortest time between two frames, in microseconds (60Hz)
+#define FRAME_INTERVAL 16667
+
+// rotationSpeed is in degrees per this many microseconds
+#define ROTATION_PERIOD 100000
 Viewer::Viewer()
 {
 	
@@ -33,11 +40,16 @@ Viewer::Viewer()
 	
 	
 	// Game starts at a slow pace of 500ms
+	speed = SLOW;
 	gameSpeed = 500;
 	
 	// By default turn double buffer on
 	doubleBuffer = false;
 	
+	// No frame has been drawn yet
+	lastFrameTime = 0;
+	animationTime = 0;
+	
 	gameOver = false;
 
 	Glib::RefPtr<Gdk::GL::Config> glconfig;
@@ -68,25 +80,111 @@ Viewer::Viewer()
 				Gdk::KEY_PRESS_MASK 		|
 				Gdk::VISIBILITY_NOTIFY_MASK);
 		
-	// Create Game
-	game = new Game(10, 20);
+	// Create Game in the standard well, seeded so that every run deals
+	// different pieces
+	sim = new SimThread(time(0), gameSpeed);
 	
-	// Start game tick timer
-	tickTimer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Viewer::gameTick), gameSpeed);
+	// The border never changes, so its cubes are collected once
+	const GameSnapshot& snapshot = sim->getSnapshot();
+	for (int y = -1;y< snapshot.height;y++)
+	{
+		borderBatch.add(y, -1, OUTLINE_COLOUR);
+		borderBatch.add(y, snapshot.width, OUTLINE_COLOUR);
+	}
+	for (int x = 0;x < snapshot.width; x++)
+	{
+		borderBatch.add(-1, x, OUTLINE_COLOUR);
+	}
+	
+	// The stack mesh is built on the first frame
+	stackDirty = true;
+	stackVersion = 0;
+	seenTicks = 0;
+	seenInputs = 0;
+	
+	// The performance overlay starts hidden, and the score is shown
+	// in the labels
+	showStats = false;
+	scoreInView = false;
+	shownScore = 0;
+	shownLines = 0;
+	viewWidth = 1;
+	viewHeight = 1;
+	
+	// Run the game on its own thread.  Each new snapshot wakes the
+	// main loop through the dispatcher.
+	snapshotReady.connect(sigc::mem_fun(*this, &Viewer::takeSnapshot));
+	sim->start(std::bind(&Glib::Dispatcher::emit, &snapshotReady));
 }
 
 Viewer::~Viewer()
 {
-	delete(game);
-  // Nothing to do here right now.
+	// Deleting the SimThread stops and joins it, before the dispatcher it
+	// wakes goes away
+	delete(sim);
 }
 
 void Viewer::invalidate()
 {
-  //Force a rerender
-  Gtk::Allocation allocation = get_allocation();
-  get_window()->invalidate_rect( allocation, false);
-  
+	// A frame is already on its way, and will show this change too
+	if (frameTimer.connected())
+		return;
+	
+	// Nothing was animating while no frame was scheduled, so the
+	// animation clock starts again from now
+	gint64 now = g_get_monotonic_time();
+	animationTime = now;
+	
+	// Draw straight away, unless that would be sooner than one frame
+	// interval after the last frame
+	gint64 wait = lastFrameTime + FRAME_INTERVAL - now;
+	if (wait < 0)
+		wait = 0;
+	frameTimer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Viewer::onFrame), wait / 1000);
+}
+
+bool Viewer::isAnimating() const
+{
+	if (rotationSpeed == 0)
+		return false;
+	
+	return (mouseB1Down && !shiftIsDown) || rotateAboutX
+		|| (mouseB2Down && !shiftIsDown) || rotateAboutY
+		|| (mouseB3Down && !shiftIsDown) || rotateAboutZ;
+}
+
+bool Viewer::onFrame()
+{
+	gint64 now = g_get_monotonic_time();
+	
+	// Spin by however much time has really passed, so the speed does
+	// not depend on how often frames are drawn
+	double step = rotationSpeed * (now - animationTime) / ROTATION_PERIOD;
+	animationTime = now;
+	
+	if ((mouseB1Down && !shiftIsDown) || rotateAboutX)
+		rotationAngleX = fmod(rotationAngleX + step, 360);
+	if ((mouseB2Down && !shiftIsDown) || rotateAboutY)
+		rotationAngleY = fmod(rotationAngleY + step, 360);
+	if ((mouseB3Down && !shiftIsDown) || rotateAboutZ)
+		rotationAngleZ = fmod(rotationAngleZ + step, 360);
+	
+	// Nothing to draw into before the widget is realized
+	if (!get_window())
+		return false;
+	
+	// Draw now rather than waiting for GDK to get round to it
+	lastFrameTime = now;
+	Gtk::Allocation allocation = get_allocation();
+	get_window()->invalidate_rect(allocation, false);
+	get_window()->process_updates(false);
+	
+	// Keep drawing while something is moving; otherwise stop until
+	// the next invalidate()
+	if (isAnimating())
+		frameTimer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Viewer::onFrame), FRAME_INTERVAL / 1000);
+	
+	return false;
 }
 
 void Viewer::on_realize()
@@ -103,15 +201,36 @@ void Viewer::on_realize()
 	if (!gldrawable->gl_begin(get_gl_context()))
 		return;
 	
+	// Nothing is known about the state of a new context
+	renderState.forget();
+	
 	// Just enable depth testing and set the background colour.
-	glEnable(GL_DEPTH_TEST);
+	renderState.enable(GL_DEPTH_TEST);
 	glClearColor(0.7, 0.7, 1.0, 0.0);
 	
+	// The cubes are drawn by a shader program
+	if (!cubeRenderer.init(renderState))
+		std::cerr << "Could not build the cube shader:" << std::endl << cubeRenderer.getLog() << std::endl;
+	
+	// set up lighting (if necessary)
+	// Followed the tutorial found http://www.falloutsoftware.com/tutorials/gl/gl8.htm
+	// to implement lighting.  One light, given in eye coordinates.  The
+	// ambient includes the 0.2 global ambient that the fixed-function
+	// pipeline added.
+	cubeRenderer.setLight(Point3D(5.0, 0.0, 0.0), Colour(0.3 + 0.2), Colour(0.8));
+	
+	makeRasterFont();
+	
+	stackMesh.init(renderState);
+	
 	gldrawable->gl_end();
 }
 
 bool Viewer::on_expose_event(GdkEventExpose* event)
 {
+	gint64 frameStart = g_get_monotonic_time();
+	const GameSnapshot& snapshot = sim->getSnapshot();
+	
 	Glib::RefPtr<Gdk::GL::Drawable> gldrawable = get_gl_drawable();
 	
 	if (!gldrawable) return false;
@@ -121,153 +240,88 @@ bool Viewer::on_expose_event(GdkEventExpose* event)
 
 	// Decide which buffer to write to
 	if (doubleBuffer)
-		glDrawBuffer(GL_BACK);	
+		renderState.drawBuffer(GL_BACK);	
 	else
-		glDrawBuffer(GL_FRONT);
+		renderState.drawBuffer(GL_FRONT);
 		
 			
 	// Clear the screen
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	// Modify the current projection matrix so that we move the 
-	// camera away from the origin.  We'll draw the game at the
-	// origin, and we need to back up to see it.
-
-	glMatrixMode(GL_PROJECTION);
-	glPushMatrix();
-	glTranslated(0.0, 0.0, -40.0);
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-	
-	// set up lighting (if necessary)
-	// Followed the tutorial found http://www.falloutsoftware.com/tutorials/gl/gl8.htm
-	// to implement lighting
-	
-	// Initialize lighting settings
-	glShadeModel(GL_SMOOTH);
-	glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
-	glEnable(GL_LIGHTING);
-	
-	// Create one light source
-	glEnable(GL_LIGHT0);
-	glEnable(GL_COLOR_MATERIAL);
-	glColorMaterial(GL_FRONT, GL_AMBIENT_AND_DIFFUSE);
-	// Define properties of light 
-	float ambientLight0[] = { 0.3f, 0.3f, 0.3f, 1.0f };
-	float diffuseLight0[] = { 0.8f, 0.8f, 0.8f, 1.0f };
-	float specularLight0[] = { 0.6f, 0.6f, 0.6f, 1.0f };
-	float position0[] = { 5.0f, 0.0f, 0.0f, 1.0f };	
-	glLightfv(GL_LIGHT0, GL_AMBIENT, ambientLight0);
-	glLightfv(GL_LIGHT0, GL_DIFFUSE, diffuseLight0);
-	glLightfv(GL_LIGHT0, GL_SPECULAR, specularLight0);
-	glLightfv(GL_LIGHT0, GL_POSITION, position0);
-	
-	// Scale and rotate the scene
-	
-	if (scaleFactor != 1)
-		glScaled(scaleFactor, scaleFactor, scaleFactor);
-		
-	if (rotationAngleX != 0)
-		glRotated(rotationAngleX, 1, 0, 0);
-	
-	if (rotationAngleY != 0)
-		glRotated(rotationAngleY, 0, 1, 0);
-
-	if (rotationAngleZ != 0)
-		glRotated(rotationAngleZ, 0, 0, 1);
-	
-	// Increment rotation angles for next render
-	if ((mouseB1Down && !shiftIsDown) || rotateAboutX)
-	{
-		rotationAngleX += rotationSpeed;
-		if (rotationAngleX > 360)
-			rotationAngleX -= 360;
-	}
-	if ((mouseB2Down && !shiftIsDown) || rotateAboutY)
-	{
-		rotationAngleY += rotationSpeed;
-		if (rotationAngleY > 360)
-			rotationAngleY -= 360;
-	}
-	if ((mouseB3Down && !shiftIsDown) || rotateAboutZ)
-	{
-		rotationAngleZ += rotationSpeed;
-		if (rotationAngleZ > 360)
-			rotationAngleZ -= 360;
-	}
-	
-	// You'll be drawing unit cubes, so the game will have width
-	// 10 and height 24 (game = 20, stripe = 4).  Let's translate
-	// the game so that we can draw it starting at (0,0) but have
-	// it appear centered in the window.
-	glTranslated(-5.0, -12.0, 0.0);
+	// Scale and rotate the scene.  You'll be drawing unit cubes, so
+	// the game will have width 10 and height 24 (game = 20, stripe =
+	// 4).  Let's translate the game so that we can draw it starting at
+	// (0,0) but have it appear centered in the window.
+	Matrix4x4 modelView = scaling(Vector3D(scaleFactor, scaleFactor, scaleFactor))
+		* rotation(rotationAngleX, 'x')
+		* rotation(rotationAngleY, 'y')
+		* rotation(rotationAngleZ, 'z')
+		* translation(Vector3D(-snapshot.width / 2.0, -snapshot.board.getRows() / 2.0, 0.0));
+	cubeRenderer.setTransform(modelView, projection);
 	
 
 	
-	// Draw Border
-	for (int y = -1;y< 20;y++)
-	{
-		drawCube(y, -1, 7, GL_LINE_LOOP);
-		
-		drawCube(y, 10, 7, GL_LINE_LOOP);
-	}
-	for (int x = 0;x < 10; x++)
-	{
-		drawCube (-1, x, 7, GL_LINE_LOOP);
-	}
+	// Draw the border, then the cells of the well.  Each batch of cubes
+	// goes to the GL in one draw call.
+	cubeRenderer.drawEdges(borderBatch, OUTLINE_COLOUR);
 	
 	// Draw current state of tetris
 	if (currentDrawMode == Viewer::WIRE)
 	{
-		for (int i = 23;i>=0;i--) // row
+		// Wireframe shows every edge of every cube, hidden or not,
+		// of the stack and of the falling piece.  Only filled cells are
+		// visited, so a wide well costs what its stack costs.
+		cellBatch.clear();
+		const GameSnapshot::BoardType& board = snapshot.board;
+		for (int i = board.getMaxHeight() - 1; i >= 0; i--) // row
 		{
-			for (int j = 9; j>=0;j--) // column
-			{
-				drawCube (i, j, game->get(i, j), GL_LINE_LOOP );
-			}
+			for (int j = board.nextFilled(i, 0); j < snapshot.width; j = board.nextFilled(i, j + 1))
+				cellBatch.add(i, j, board.get(i, j));
 		}
+		for (int i = 0; i < snapshot.activeCount; i++)
+			cellBatch.add(snapshot.active[i][0], snapshot.active[i][1], snapshot.activeColour);
+		cubeRenderer.drawEdges(cellBatch);
 	}
-	else if (currentDrawMode == Viewer::MULTICOLOURED)
+	else
 	{
-		for (int i = 23;i>=0;i--) // row
+		// The locked stack only changes when a piece locks or rows
+		// clear, so its mesh is kept until then
+		if (stackDirty || snapshot.stackVersion != stackVersion)
 		{
-			for (int j = 9; j>=0;j--) // column
-			{	
-				// Draw outline for cube
-				if (game->get(i, j) != -1)
-					drawCube(i, j, 7, GL_LINE_LOOP);
-					
-				drawCube (i, j, game->get(i, j), GL_QUADS, true );
-			}
+			stackMesh.build(snapshot.board, currentDrawMode == Viewer::MULTICOLOURED);
+			stackDirty = false;
+			stackVersion = snapshot.stackVersion;
 		}
+		
+		// The falling piece is drawn on its own, cube by cube
+		cellBatch.clear();
+		for (int i = 0; i < snapshot.activeCount; i++)
+			cellBatch.add(snapshot.active[i][0], snapshot.active[i][1], snapshot.activeColour);
+		
+		// Draw outline for cubes, then their faces
+		stackMesh.drawEdges(cubeRenderer);
+		cubeRenderer.drawEdges(cellBatch, OUTLINE_COLOUR);
+		stackMesh.drawFaces(cubeRenderer);
+		cubeRenderer.drawFaces(cellBatch, currentDrawMode == Viewer::MULTICOLOURED);
 	}
-	else if (currentDrawMode == Viewer::FACE)
-	{
-		for (int i = 23;i>=0;i--) // row
-		{
-			for (int j = 9; j>=0;j--) // column
-			{				
-				// Draw outline for cube
-				if (game->get(i, j) != -1)
-					drawCube(i, j, 7, GL_LINE_LOOP);
-					
-				drawCube (i, j, game->get(i, j), GL_QUADS );
-			}
-		}	
-	}	
 	
 	if (gameOver)
 	{
 		// Some game over animation
 	}
 	
- 	// We pushed a matrix onto the PROJECTION stack earlier, we 
-	// need to pop it.
-
-	glMatrixMode(GL_PROJECTION);
-	glPopMatrix();
-
+	// Overlays go in one batch.  The performance overlay shows the
+	// frames before this one.
+	if (showStats || scoreInView)
+	{
+		textRenderer.clear();
+		if (showStats)
+			addStats();
+		if (scoreInView)
+			addScore();
+		textRenderer.draw(viewWidth, viewHeight);
+	}
+	
 	// Swap the contents of the front and back buffers so we see what we
 	// just drew. This should only be done if double buffering is enabled.
 	if (doubleBuffer)
@@ -276,6 +330,8 @@ bool Viewer::on_expose_event(GdkEventExpose* event)
 		glFlush();	
 		
 	gldrawable->gl_end();
+	
+	perfStats.frameDrawn(frameStart, g_get_monotonic_time());
 
 	return true;
 }
@@ -292,14 +348,14 @@ bool Viewer::on_configure_event(GdkEventConfigure* event)
   // Set up perspective projection, using current size and aspect
   // ratio of display
 
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
   glViewport(0, 0, event->width, event->height);
-  gluPerspective(40.0, (GLfloat)event->width/(GLfloat)event->height, 0.1, 1000.0);
-
-  // Reset to modelview matrix mode
+  viewWidth = event->width;
+  viewHeight = event->height;
   
-  glMatrixMode(GL_MODELVIEW);
+  // Move the camera away from the origin.  We'll draw the game at the
+  // origin, and we need to back up to see it.
+  projection = perspective(40.0, (double)event->width/(double)event->height, 0.1, 1000.0)
+    * translation(Vector3D(0.0, 0.0, -40.0));
 
   gldrawable->gl_end();
 
@@ -315,10 +371,7 @@ bool Viewer::on_button_press_event(GdkEventButton* event)
 	
 	// Stop rotating if a mosue button was clicked and the shift button is not down
 	if ((rotateAboutX || rotateAboutY || rotateAboutZ) && !shiftIsDown)
-	{
 		rotationSpeed = 0;
-		rotateTimer.disconnect();
-	}
 		
 	// Set our appropriate flags to true
 	if (event->button == 1)
@@ -406,8 +459,6 @@ bool Viewer::on_motion_notify_event(GdkEventMotion* event)
 			
 		startScalePos[0] = event->x;
 		startScalePos[1] = event->y;
-		if (rotateTimer.connected())
-			return true;
 	}
 	else // Start rotating
 	{
@@ -424,10 +475,6 @@ bool Viewer::on_motion_notify_event(GdkEventMotion* event)
 			rotationAngleY += x2x1;
 		if (mouseB3Down) // Rotate z
 			rotationAngleZ += x2x1;
-			
-		// Reset the tickTimer
-		if (!rotateTimer.connected())
-			rotateTimer = Glib::signal_timeout().connect(sigc::bind(sigc::mem_fun(*this, &Viewer::on_expose_event), (GdkEventExpose *)NULL), 100);
 	}
 	
 	// Store the position of the cursor
@@ -437,145 +484,6 @@ bool Viewer::on_motion_notify_event(GdkEventMotion* event)
 	return true;
 }
 
-void Viewer::drawCube(int y, int x, int colourId, GLenum mode, bool multiColour)
-{
-	if (mode == GL_LINE_LOOP)
-		glLineWidth (2);
-	
-	double r, g, b;
-	r = 0;
-	g = 0;
-	b = 0;
-	switch (colourId)
-	{
-		case 0:	// blue
-			r = 0.514;
-			g = 0.839;
-			b = 0.965;
-			break;              
-		case 1:	// purple       
-			r = 0.553;          
-			g = 0.6;            
-			b = 0.796;          
-			break;              
-		case 2: // orange       
-			r = 0.988;          
-			g = 0.627;          
-			b = 0.373;          
-			break;              
-		case 3:	// green        
-			r = 0.69;           
-			g = 0.835;          
-			b = 0.529;          
-			break;              
-		case 4:	// red          
-			r = 1.00;           
-			g = 0.453;          
-			b = 0.339;          
-			break;              
-		case 5:	// pink         
-			r = 0.949;          
-			g = 0.388;          
-			b = 0.639;          
-			break;              
-		case 6:	// yellow       
-			r = 1;              
-			g = 0.792;          
-			b = 0.204;          
-			break;
-		case 7:	// black
-			r = 0;
-			g = r;
-			b = g;
-			break;
-		default:
-			return;
-	}
-	
-	double innerXMin = 0;
-	double innerYMin = 0;
-	double innerXMax = 1;
-	double innerYMax = 1;
-	double zMax = 1;
-	double zMin = 0;
-	
-	// Front face
-	glNormal3d(1, 0, 0);
-		
-	glColor3d(r, g, b);
-	glBegin(mode);
-		glVertex3d(innerXMin + x, innerYMin + y, zMax);
-		glVertex3d(innerXMax + x, innerYMin + y, zMax);
-		glVertex3d(innerXMax + x, innerYMax + y, zMax);
-		glVertex3d(innerXMin + x, innerYMax + y, zMax);
-	glEnd();
-	
-	// top face
-	glNormal3d(0, 1, 0);
-	
-	if (multiColour)
-		glColor3d(g, r, b);
-
-	glBegin(mode);
-		glVertex3d(innerXMin + x, innerYMax + y, zMin);
-		glVertex3d(innerXMax + x, innerYMax + y, zMin);
-		glVertex3d(innerXMax + x, innerYMax + y, zMax);
-		glVertex3d(innerXMin + x, innerYMax + y, zMax);
-	glEnd();
-	
-	// left face
-	glNormal3d(0, 0, 1);
-	
-	if (multiColour)
-		glColor3d(b, g, r);
-
-	glBegin(mode);
-		glVertex3d(innerXMin + x, innerYMin + y, zMin);
-		glVertex3d(innerXMin + x, innerYMax + y, zMin);
-		glVertex3d(innerXMin + x, innerYMax + y, zMax);
-		glVertex3d(innerXMin + x, innerYMin + y, zMax);
-	glEnd();
-	
-	// bottom face
-	glNormal3d(0, 1, 0);
-	
-	if (multiColour)
-		glColor3d(r, b, g);	
-
-	glBegin(mode);
-		glVertex3d(innerXMin + x, innerYMin + y, zMin);
-		glVertex3d(innerXMax + x, innerYMin + y, zMin);
-		glVertex3d(innerXMax + x, innerYMin + y, zMax);
-		glVertex3d(innerXMin + x, innerYMin + y, zMax);
-	glEnd();
-	
-	// right face
-	glNormal3d(0, 0, 1);
-	
-	if (multiColour)
-		glColor3d(b, r, g);
-	
-	glBegin(mode);
-		glVertex3d(innerXMax + x, innerYMin + y, zMin);
-		glVertex3d(innerXMax + x, innerYMax + y, zMin);
-		glVertex3d(innerXMax + x, innerYMax + y, zMax);
-		glVertex3d(innerXMax + x, innerYMin + y, zMax);
-	glEnd();
-	
-	// Back of front face
-	glNormal3d(1, 0, 0);
-
-	if (multiColour)
-		glColor3d(g, b, r);
-
-	glBegin(mode);
-		glVertex3d(innerXMin + x, innerYMin + y, zMin);
-		glVertex3d(innerXMax + x, innerYMin + y, zMin);
-		glVertex3d(innerXMax + x, innerYMax + y, zMin);
-		glVertex3d(innerXMin + x, innerYMax + y, zMin);
-	glEnd();
-}
-
 void Viewer::startScale()
 {
 	shiftIsDown = true;
@@ -605,9 +513,9 @@ void Viewer::setSpeed(Speed newSpeed)
 			break;
 	}
 	
-	// Update game tick timer
-	tickTimer.disconnect();
-	tickTimer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Viewer::gameTick), gameSpeed);
+	// The simulation thread changes its tick rate
+	SimEvent event = { SimEvent::SET_SPEED, gameSpeed, g_get_monotonic_time() };
+	sim->post(event);
 }
 
 void Viewer::toggleBuffer() 
@@ -620,6 +528,9 @@ void Viewer::toggleBuffer()
 void Viewer::setDrawMode(DrawMode mode)
 {
 	currentDrawMode = mode;
+	
+	// The stack mesh carries its colours
+	stackDirty = true;
 	invalidate();
 }
 
@@ -629,58 +540,51 @@ bool Viewer::on_key_press_event( GdkEventKey *ev )
 	if (gameOver)
 		return true;
 	
+	Action action = ACTION_NONE;
 	if (ev->keyval == GDK_Left)
-		game->moveLeft();
+		action = ACTION_LEFT;
 	else if (ev->keyval == GDK_Right)
-		game->moveRight();
+		action = ACTION_RIGHT;
 	else if (ev->keyval == GDK_Up)
-		game->rotateCCW();
+		action = ACTION_ROTATE_CCW;
 	else if (ev->keyval == GDK_Down)
-		game->rotateCW();
+		action = ACTION_ROTATE_CW;
 	else if (ev->keyval == GDK_space)
-		game->drop();
-		
-	invalidate();
+		action = ACTION_DROP;
+	
+	// The move happens on the simulation thread.  The time it was
+	// pressed comes back with the snapshot that shows it.
+	if (action != ACTION_NONE)
+	{
+		SimEvent event = { SimEvent::ACTION, action, g_get_monotonic_time() };
+		sim->post(event);
+	}
 	return true;
 }
 
-bool Viewer::gameTick()
+void Viewer::takeSnapshot()
 {
-	int returnVal = game->tick();
-	
-	// String streams used to print score and lines cleared	
-	std::stringstream scoreStream, linesStream; 
-	std::string s;
-	
-	// Update the score
-	scoreStream << game->getScore();
-	scoreLabel->set_text("Score:\t" + scoreStream.str());
-	
-	// If a line was cleared update the linesCleared widget
-	if (returnVal > 0)
-	{
-    	linesStream << game->getLinesCleared();
-		linesClearedLabel->set_text("Lines Cleared:\t" + linesStream.str());
-	}
+	// Several snapshots may have been published since the last call;
+	// only the latest matters
+	if (!sim->update())
+		return;
 	
-	if (game->getLinesCleared() / 10 > (DEFAULT_GAME_SPEED - gameSpeed) / 50 && gameSpeed > 75)
+	const GameSnapshot& snapshot = sim->getSnapshot();
+	if (snapshot.tickCount != seenTicks)
 	{
-		// Increase the game speed
-		gameSpeed -= 50;
-		
-		// Update game tick timer
-		tickTimer.disconnect();
-		tickTimer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Viewer::gameTick), gameSpeed);
+		perfStats.tick(snapshot.tickLate);
+		seenTicks = snapshot.tickCount;
 	}
-	
-	if (returnVal < 0)
+	if (snapshot.inputCount != seenInputs)
 	{
-		gameOver = true;
-		tickTimer.disconnect();
+		perfStats.input(snapshot.inputTime);
+		seenInputs = snapshot.inputCount;
 	}
 	
+	gameSpeed = snapshot.gameSpeed;
+	gameOver = snapshot.gameOver;
+	updateScore();
 	invalidate();
-	return true;
 }
 
 void Viewer::resetView()
@@ -693,7 +597,6 @@ void Viewer::resetView()
 	rotateAboutX = false;
 	rotateAboutY = false;
 	rotateAboutZ = false;
-	rotateTimer.disconnect();
 	
 	scaleFactor = 1;
 	invalidate();
@@ -702,24 +605,50 @@ void Viewer::resetView()
 void Viewer::newGame()
 {
 	gameOver = false;
-	game->reset();
 	
 	// Restore gamespeed to whatever was set in the menu
 	setSpeed(speed);
 	
-	// Reset the tickTimer
-	tickTimer.disconnect();
-	tickTimer = Glib::signal_timeout().connect(sigc::mem_fun(*this, &Viewer::gameTick), gameSpeed);
-	
-	std::stringstream scoreStream, linesStream; 
-	std::string s;
-	
-	// Update the score
-	scoreStream << game->getScore();
-	scoreLabel->set_text("Score:\t" + scoreStream.str());
-	linesStream << game->getLinesCleared();
-	linesClearedLabel->set_text("Lines Cleared:\t" + linesStream.str());
+	SimEvent event = { SimEvent::NEW_GAME, gameSpeed, g_get_monotonic_time() };
+	sim->post(event);
+}
+
+void Viewer::updateScore()
+{
+	// Only touch the labels when their text changes: setting it makes
+	// GTK lay the window out again
+	const GameSnapshot& snapshot = sim->getSnapshot();
+	char text[64];
+	if (snapshot.score != shownScore)
+	{
+		shownScore = snapshot.score;
+		snprintf(text, sizeof(text), "Score:\t%d", shownScore);
+		scoreLabel->set_text(text);
+	}
+	if (snapshot.linesCleared != shownLines)
+	{
+		shownLines = snapshot.linesCleared;
+		snprintf(text, sizeof(text), "Lines Cleared:\t%d", shownLines);
+		linesClearedLabel->set_text(text);
+	}
+}
+
+void Viewer::toggleScoreInView()
+{
+	scoreInView = !scoreInView;
 	
+	// The labels give their space back to the view while it shows
+	// the score itself
+	if (scoreInView)
+	{
+		scoreLabel->hide();
+		linesClearedLabel->hide();
+	}
+	else
+	{
+		scoreLabel->show();
+		linesClearedLabel->show();
+	}
 	invalidate();
 }
 
@@ -728,3 +657,89 @@ void Viewer::setScoreWidgets(Gtk::Label *score, Gtk::Label *linesCleared)
 	scoreLabel = score;
 	linesClearedLabel = linesCleared;
 }
+
+void Viewer::toggleStats()
+{
+	showStats = !showStats;
+	perfStats.reset();
+	invalidate();
+}
+
+void Viewer::makeRasterFont()
+{
+	if (!textRenderer.init(renderState))
+		std::cerr << "Could not build the text shader:" << std::endl << textRenderer.getLog() << std::endl;
+}
+
+void Viewer::printString(const char *s)
+{
+	// Print at the text cursor, and move it down a line
+	textRenderer.print(textX, textY, s);
+	textY += (TextRenderer::CELL_HEIGHT + 2) * textRenderer.getScale();
+}
+
+void Viewer::addScore()
+{
+	char line[64];
+	const int scale = textRenderer.getScale();
+	
+	// Top right corner, right aligned
+	snprintf(line, sizeof(line), "SCORE %d", shownScore);
+	textX = viewWidth - 8 - (float)strlen(line) * TextRenderer::CELL_WIDTH * scale;
+	textY = 8;
+	printString(line);
+	snprintf(line, sizeof(line), "LINES %d", shownLines);
+	textX = viewWidth - 8 - (float)strlen(line) * TextRenderer::CELL_WIDTH * scale;
+	printString(line);
+}
+
+void Viewer::addStats()
+{
+	const int scale = textRenderer.getScale();
+	const float lineHeight = (TextRenderer::CELL_HEIGHT + 2) * scale;
+	const float barWidth = 4 * scale;
+	const float histogramHeight = 24 * scale;
+	char line[64];
+	
+	// A dark panel behind the text, sized for five lines of up to 30
+	// characters and the histogram
+	float x = 8, y = 8;
+	textRenderer.rect(x, y, 30 * TextRenderer::CELL_WIDTH * scale + 16, 5 * lineHeight + histogramHeight + 24, 0, 0, 0, 0.6);
+	textX = x + 8;
+	textY = y + 8;
+	
+	snprintf(line, sizeof(line), "FPS %d  FRAME %.2f MS",
+		perfStats.getFramesPerSecond(), perfStats.getFrameTime() / 1000.0);
+	printString(line);
+	
+	int64_t p99 = perfStats.getFramePercentile(0.99);
+	snprintf(line, sizeof(line), "P99 %.2f MS", p99 / 1000.0);
+	printString(line);
+	
+	// Frame-time histogram, one bar per millisecond, with the bar
+	// holding the 99th percentile in red
+	int tallest = 1;
+	for (int i = 0; i < PerfStats::BINS; ++i)
+		tallest = std::max(tallest, perfStats.getHistogramBin(i));
+	int p99Bin = std::min<int64_t>(p99 / 1000, PerfStats::BINS - 1);
+	for (int i = 0; i < PerfStats::BINS; ++i)
+	{
+		float h = histogramHeight * perfStats.getHistogramBin(i) / tallest;
+		float bx = textX + i * barWidth;
+		if (i == p99Bin)
+			textRenderer.rect(bx, textY + histogramHeight - h, barWidth - 1, h, 1, 0.3, 0.3);
+		else
+			textRenderer.rect(bx, textY + histogramHeight - h, barWidth - 1, h, 0.5, 0.9, 0.5);
+	}
+	textY += histogramHeight + 8;
+	
+	snprintf(line, sizeof(line), "TICK %d MS  LATE %+.2f MS",
+		gameSpeed, perfStats.getTickJitter() / 1000.0);
+	printString(line);
+	snprintf(line, sizeof(line), "JITTER %.2f MS  MAX %.2f MS",
+		perfStats.getMeanTickJitter() / 1000.0, perfStats.getMaxTickJitter() / 1000.0);
+	printString(line);
+	snprintf(line, sizeof(line), "INPUT %.2f MS  MAX %.2f MS",
+		perfStats.getInputLatency() / 1000.0, perfStats.getMaxInputLatency() / 1000.0);
+	printString(line);
+}
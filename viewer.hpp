@@ -4,7 +4,10 @@
 #include "algebra.hpp"
 #include <gtkmm.h>
 #include <gtkglmm.h>
-#include "game.hpp"
+#include "simthread.hpp"
+#include "renderer.hpp"
+#include "text.hpp"
+#include "perfstats.hpp"
 
 // The "main" OpenGL widget
 class Viewer : public Gtk::GL::DrawingArea {
@@ -26,7 +29,8 @@ public:
 	// A useful function that forces this widget to rerender. If you
 	// want to render a new frame, do not call on_expose_event
 	// directly. Instead call this, which will cause an on_expose_event
-	// call when the time is right.
+	// call when the time is right.  Any number of calls between two
+	// frames give one frame.
 	void invalidate();
 	void setDrawMode(DrawMode newDrawMode);
 	
@@ -39,15 +43,23 @@ public:
 	void setSpeed(Speed newSpeed);
 	
 	void toggleBuffer();
-
-	bool gameTick();
 		
 	virtual bool on_key_press_event( GdkEventKey *ev );
 		
 	void resetView();
 	void newGame();
 	
+	// Show or hide the performance overlay
+	void toggleStats();
+	
+	// Show the score and lines cleared in the view instead of in the
+	// label widgets, or back again
+	void toggleScoreInView();
+	
+	// Build the bitmap font used for overlay text
 	void makeRasterFont();
+	// Add a line of overlay text at the text cursor, and move the
+	// cursor to the next line
 	void printString(const char *s);
 	
 	void setScoreWidgets(Gtk::Label *score, Gtk::Label *linesCleared);
@@ -77,8 +89,24 @@ protected:
 
 private:
 
-	void drawCube(int y, int x, int colourId, GLenum mode, bool multiColour = false);
+	// Pick up the latest snapshot from the simulation thread, and ask
+	// for a frame to show it
+	void takeSnapshot();
+	
+	// Draw a scheduled frame, first moving any animation on by the
+	// time since the last one
+	bool onFrame();
+	
+	// Whether the view is spinning and needs frames without being asked
+	bool isAnimating() const;
 	
+	// Add the performance overlay, or the score, to the overlay text
+	void addStats();
+	void addScore();
+	
+	// Bring the score labels up to date, if the values changed
+	void updateScore();
+
 	DrawMode currentDrawMode;
 	
 	// The angle at which we are currently rotated
@@ -96,6 +124,9 @@ private:
 	// What factor we are scaling the game by currently
 	double scaleFactor;
 	
+	// Perspective projection for the current window size
+	Matrix4x4 projection;
+	
 	
 	Point2D startPos, mouseDownPos, startScalePos, endScalePos;
 	
@@ -105,35 +136,66 @@ private:
 	// Flag that determines when to use doubleBuffer
 	bool doubleBuffer;
 	
-	// Timer used to call the tick method
-	sigc::connection tickTimer;
+	// Timer for the next frame; only connected while a frame is due
+	sigc::connection frameTimer;
 	
-	// Timer for rotate
-	sigc::connection rotateTimer;
+	// When the last frame was drawn, and the time up to which the
+	// rotation has been advanced, in microseconds
+	gint64 lastFrameTime, animationTime;
 
 	// Timer for persistant rotations
 	guint32 timeOfLastMotionEvent;
 	
-	// Used to keep track of when to increase game speed
-	int linesLeftTillNextLevel;
-	
 	// The number of milliseconds before the next game tick
 	int gameSpeed;
 	
 	// Speed value set by menu
 	Speed speed;
 	
-	// Pointer to the actual game
-	Game *game;
+	// The game, running on its own thread
+	SimThread *sim;
+	
+	// Wakes the main loop when the simulation publishes a snapshot
+	Glib::Dispatcher snapshotReady;
+	
+	// The snapshot stack version the mesh was built from, and the last
+	// tick and input counted in the performance stats
+	unsigned stackVersion, seenTicks, seenInputs;
 	
 	// Game over flag
 	bool gameOver;
 	
-	// Lighting flag
-	bool lightingFlag;
-		
-	// Label widgets
+	// Label widgets, and the values they show
 	Gtk::Label *scoreLabel, *linesClearedLabel;
+	int shownScore, shownLines;
+	
+	// Whether the score is drawn in the view rather than the labels
+	bool scoreInView;
+	
+	// The GL state set so far, so that no call repeats it
+	RenderState renderState;
+	
+	// Draws batches of cubes
+	CubeRenderer cubeRenderer;
+	
+	// Overlay text, with the position printString writes at
+	TextRenderer textRenderer;
+	float textX, textY;
+	
+	// Frame and tick timings, and whether they are shown
+	PerfStats perfStats;
+	bool showStats;
+	
+	// Size of the window in pixels
+	int viewWidth, viewHeight;
+	
+	// Cubes of the well border, and of the cells in the current frame
+	// that are not part of the stack mesh
+	CubeBatch borderBatch, cellBatch;
+	
+	// The locked cells, and whether they changed since it was built
+	StackMesh stackMesh;
+	bool stackDirty;
 };
 
 #endif